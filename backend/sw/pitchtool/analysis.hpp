@@ -0,0 +1,161 @@
+#pragma once
+#include "sw/pitchtool/resampler.hpp"
+#include "sw/pitchtool/types.hpp"
+#include <sw/dft/spectrum.hpp>
+#include <sw/dft/transform.hpp>
+#include <sw/ranges/utils.hpp>
+#include <sw/signals.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace sw::pitchtool {
+
+namespace detail {
+
+/// Half open range of bin indices
+struct BinRange
+{
+    size_t begin{0u};
+    size_t end{std::numeric_limits<size_t>::max()};
+};
+
+template<std::floating_point F>
+BinRange toBinRange(const Band<F> &band, const size_t numValues, const F sampleRate)
+{
+    const auto binFrequencyStep = dft::binFrequencyStep(dft::signalLength(numValues), sampleRate);
+    const auto toIndex = [&](const F frequency) {
+        return static_cast<size_t>(
+          std::clamp(std::ceil(frequency / binFrequencyStep), math::zero<F>, static_cast<F>(numValues)));
+    };
+    const auto begin = toIndex(band.lowFrequency);
+    return {begin, std::max(begin, toIndex(band.highFrequency))};
+}
+
+template<std::floating_point F>
+void toFilteredSpectrum(const std::span<const SpectrumValue<F>> binSpectrum,
+                        std::vector<SpectrumValue<F>> &o_spectrum, const BinRange binRange = {})
+{
+    o_spectrum.clear();
+    const auto end = binSpectrum.begin() + static_cast<int>(std::min(binRange.end, binSpectrum.size()));
+    const auto begin = std::min(end, binSpectrum.begin() + static_cast<int>(std::max<size_t>(binRange.begin, 1u)));
+    std::copy_if(begin, end, std::back_inserter(o_spectrum),
+                 [zeroGainThresholdLinear = dBToFactor(static_cast<F>(-60))](const auto &value) {
+                     return value.gain > zeroGainThresholdLinear;
+                 });
+    identifyFrequencies(o_spectrum);
+}
+
+}    // namespace detail
+
+/// Finds the fundamental frequency on a decimated copy of the input, with a correspondingly smaller FFT at its own
+/// hop rate. Fundamentals of voices are low enough to survive the decimation. Memory is allocated on construction.
+template<std::floating_point F>
+class PitchDetector
+{
+public:
+    static constexpr size_t tapsPerPhase{16u};
+
+    /// fftLength and overSampling at the decimated rate, maxInputSize is the largest signal passed to process
+    PitchDetector(const size_t decimationFactor, const size_t fftLength, const size_t overSampling,
+                  const size_t maxInputSize)
+        : m_decimationFactor(decimationFactor)
+        , m_stepSize(fftLength / overSampling)
+        , m_taps(detail::makeResamplingFilter<F>(decimationFactor, tapsPerPhase))
+        , m_highSignal(m_taps.size() - 1u + maxInputSize, math::zero<F>)
+        , tmp_decimatedSignal(maxInputSize / decimationFactor + 1u, math::zero<F>)
+        , m_window(makeVonHannWindow<F>(fftLength))
+        , m_signal(fftLength, math::zero<F>)
+        , tmp_windowedSignal(fftLength, math::zero<F>)
+        , m_fft(fftLength)
+        , m_coefficients(nyquistLength(fftLength))
+        , m_binSpectrum(nyquistLength(fftLength))
+        , m_phases(nyquistLength(fftLength), math::zero<F>)
+    {
+        m_spectrum.reserve(nyquistLength(fftLength));
+    }
+
+    size_t decimationFactor() const { return m_decimationFactor; }
+
+    size_t fftLength() const { return m_signal.size(); }
+
+    /// The fundamental frequency (leq 0 if none found) if signal completed a hop, nothing otherwise
+    std::optional<F> process(const std::span<const F> signal, const F sampleRate, const Band<F> &band)
+    {
+        const auto numHistory = m_taps.size() - 1u;
+        assert(signal.size() <= m_highSignal.size() - numHistory);
+
+        std::ranges::copy(signal, m_highSignal.begin() + static_cast<int>(numHistory));
+        auto numDecimated = 0u;
+        for (auto i = 0u; i < signal.size(); ++i)
+        {
+            if (++m_decimationPhase < m_decimationFactor)
+                continue;
+            m_decimationPhase = 0u;
+            const auto newest = m_highSignal.begin() + static_cast<int>(numHistory + i);
+            tmp_decimatedSignal[numDecimated++] =
+              std::inner_product(m_taps.begin(), m_taps.end(), std::make_reverse_iterator(newest + 1), math::zero<F>);
+        }
+        std::shift_left(m_highSignal.begin(), m_highSignal.begin() + static_cast<int>(numHistory + signal.size()),
+                        static_cast<int>(signal.size()));
+
+        std::shift_left(m_signal.begin(), m_signal.end(), static_cast<int>(numDecimated));
+        std::copy(tmp_decimatedSignal.begin(), tmp_decimatedSignal.begin() + numDecimated,
+                  m_signal.end() - static_cast<int>(numDecimated));
+
+        m_numSinceHop += numDecimated;
+        if (m_numSinceHop < m_stepSize)
+            return std::nullopt;
+
+        const auto decimatedSampleRate = sampleRate / static_cast<F>(m_decimationFactor);
+        const auto timeDiff = static_cast<F>(m_numSinceHop) / decimatedSampleRate;
+        m_numSinceHop = 0u;
+
+        std::transform(m_window.begin(), m_window.end(), m_signal.begin(), tmp_windowedSignal.begin(),
+                       std::multiplies());
+        m_fft.transform(tmp_windowedSignal, m_coefficients);
+        dft::toSpectrumByPhase<F>(decimatedSampleRate, timeDiff, std::span(m_phases), std::span(m_coefficients),
+                                  std::span(m_binSpectrum), std::span(m_phases));
+
+        const auto binRange = detail::toBinRange(band, m_binSpectrum.size(), decimatedSampleRate);
+        detail::toFilteredSpectrum<F>(m_binSpectrum, m_spectrum, binRange);
+
+        const auto bandSpectrum = std::span(m_binSpectrum).subspan(binRange.begin, binRange.end - binRange.begin);
+        const auto squaredGainsThreshold =
+          static_cast<F>(0.3) *
+          ranges::accumulate<F>(gains<F>(bandSpectrum) |
+                                std::views::transform([](const auto gain) { return gain * gain; }));
+        return findFundamental<F>(m_spectrum, squaredGainsThreshold).frequency;
+    }
+
+    size_t memoryFootprint() const
+    {
+        return (m_taps.capacity() + m_highSignal.capacity() + tmp_decimatedSignal.capacity() + m_window.capacity() +
+                m_signal.capacity() + tmp_windowedSignal.capacity() + m_phases.capacity()) *
+                 sizeof(F) +
+               m_coefficients.capacity() * sizeof(std::complex<F>) +
+               (m_binSpectrum.capacity() + m_spectrum.capacity()) * sizeof(SpectrumValue<F>);
+    }
+
+private:
+    size_t m_decimationFactor;
+    size_t m_stepSize;
+    std::vector<F> m_taps;
+    std::vector<F> m_highSignal;    ///< filter history followed by the current signal
+    std::vector<F> tmp_decimatedSignal;
+    std::vector<F> m_window;
+    std::vector<F> m_signal;    ///< the latest fftLength decimated samples
+    std::vector<F> tmp_windowedSignal;
+    sw::dft::FFT<F> m_fft;
+    std::vector<std::complex<F>> m_coefficients;
+    std::vector<SpectrumValue<F>> m_binSpectrum;
+    std::vector<F> m_phases;
+    std::vector<SpectrumValue<F>> m_spectrum;
+    size_t m_decimationPhase{0u};
+    size_t m_numSinceHop{0u};
+};
+
+}    // namespace sw::pitchtool
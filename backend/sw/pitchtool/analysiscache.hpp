@@ -0,0 +1,225 @@
+#pragma once
+#include "sw/pitchtool/arena.hpp"
+#include "sw/pitchtool/types.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace sw::pitchtool {
+
+namespace detail {
+
+/// Zero initialized anonymous memory mapping, of which only the address space is reserved. A range has to be
+/// committed before it is accessed, and pages are only backed by physical memory once they are written, so a
+/// generous bound costs what is actually used. Throws std::bad_alloc if the address space cannot be reserved.
+class MappedMemory
+{
+public:
+    explicit MappedMemory(const size_t size): m_size(size)
+    {
+#if defined(_WIN32)
+        m_data = static_cast<std::byte *>(VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS));
+        if (m_data == nullptr)
+            throw std::bad_alloc();
+#else
+        void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (data == MAP_FAILED)
+            throw std::bad_alloc();
+        m_data = static_cast<std::byte *>(data);
+#endif
+    }
+
+    MappedMemory(const MappedMemory &) = delete;
+    MappedMemory &operator=(const MappedMemory &) = delete;
+
+    ~MappedMemory()
+    {
+#if defined(_WIN32)
+        VirtualFree(m_data, 0u, MEM_RELEASE);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+
+    /// Makes the pages of a range accessible, false if the system cannot commit them. Without overcommitment, as
+    /// on Windows, this charges the commit limit, otherwise nothing is charged before pages are written.
+    bool commit([[maybe_unused]] const size_t offset, [[maybe_unused]] const size_t size)
+    {
+#if defined(_WIN32)
+        return VirtualAlloc(m_data + offset, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+        return true;
+#endif
+    }
+
+    std::byte *data() const { return m_data; }
+
+    size_t size() const { return m_size; }
+
+private:
+    std::byte *m_data{nullptr};
+    size_t m_size;
+};
+
+/// FNV-1a over the bit patterns of values, continuing from seed
+template<std::floating_point F>
+std::uint64_t hashValues(const std::span<const F> values, std::uint64_t seed = 14695981039346656037ull)
+{
+    using Bits = std::conditional_t<sizeof(F) == 8u, std::uint64_t, std::uint32_t>;
+    for (const auto value : values)
+    {
+        seed ^= static_cast<std::uint64_t>(std::bit_cast<Bits>(value));
+        seed *= 1099511628211ull;
+    }
+    return seed;
+}
+
+}    // namespace detail
+
+/// Analysis results of processing steps, keyed by the timeline position of the step. Repeated playback of the same
+/// input, e.g. a loop in the host, can take phases, spectrum and fundamental from here instead of analysing again.
+/// An entry is only valid for a step whose own input window and the window before hash like the stored ones, as
+/// the analysis depends on both. Positions map to slots directly, a newer step overwrites an older one of the same
+/// slot. All address space is reserved on construction, the memory of a slot is committed when it is first stored.
+template<std::floating_point F>
+class AnalysisCache
+{
+public:
+    /// Analysis results to fill or take over, with nyquistLength(fftLength) values each
+    struct Entry
+    {
+        std::span<std::complex<F>> coefficients;
+        std::span<SpectrumValue<F>> binSpectrum;
+        std::span<F> phases;
+        F &fundamentalFrequency;
+    };
+
+    /// maxSize bounds the memory in bytes, positions are in samples at the processing rate
+    AnalysisCache(const size_t fftLength, const size_t stepSize, const size_t maxSize)
+        : m_numValues(nyquistLength(fftLength))
+        , m_stepSize(stepSize)
+        , m_entrySize(Arena::blockSize<Header>(1u) + Arena::blockSize<std::complex<F>>(m_numValues) +
+                      Arena::blockSize<SpectrumValue<F>>(m_numValues) + Arena::blockSize<F>(m_numValues))
+        , m_numEntries(std::max<size_t>(1u, maxSize / m_entrySize))
+        , m_memory(m_numEntries * m_entrySize)
+        , m_isSlotCommitted(m_numEntries, false)
+    {}
+
+    size_t numEntries() const { return m_numEntries; }
+
+    /// reserved bytes, memory is only committed for entries stored so far
+    size_t size() const { return m_memory.size(); }
+
+    /// The entry stored for position and hashes, if any
+    std::optional<Entry> find(const std::int64_t position, const std::uint64_t windowHash,
+                              const std::uint64_t previousWindowHash)
+    {
+        if (!m_isSlotCommitted[slotIndex(position)])
+        {
+            ++m_numMisses;
+            return std::nullopt;
+        }
+        auto &header = headerAt(position);
+        if (!header.isValid || header.position != position || header.windowHash != windowHash ||
+            header.previousWindowHash != previousWindowHash)
+        {
+            ++m_numMisses;
+            return std::nullopt;
+        }
+        ++m_numHits;
+        return entryAt(position);
+    }
+
+    /// The entry for position, to be filled by the caller, replacing what its slot held before. std::nullopt if the
+    /// memory of a slot stored for the first time cannot be committed.
+    std::optional<Entry> store(const std::int64_t position, const std::uint64_t windowHash,
+                               const std::uint64_t previousWindowHash)
+    {
+        const auto slot = slotIndex(position);
+        if (!m_isSlotCommitted[slot])
+        {
+            if (!m_memory.commit(slot * m_entrySize, m_entrySize))
+                return std::nullopt;
+            m_isSlotCommitted[slot] = true;
+        }
+        headerAt(position) = {position, windowHash, previousWindowHash, math::zero<F>, true};
+        return entryAt(position);
+    }
+
+    /// drops all entries, e.g. when the input is known to have changed
+    void clear()
+    {
+        for (size_t slot = 0u; slot < m_numEntries; ++slot)
+        {
+            if (m_isSlotCommitted[slot])
+                reinterpret_cast<Header *>(m_memory.data() + slot * m_entrySize)->isValid = false;
+        }
+    }
+
+    size_t numHits() const { return m_numHits; }
+
+    size_t numMisses() const { return m_numMisses; }
+
+private:
+    struct Header
+    {
+        std::int64_t position;
+        std::uint64_t windowHash;
+        std::uint64_t previousWindowHash;
+        F fundamentalFrequency;
+        bool isValid;    ///< false in zero initialized memory
+    };
+
+    size_t slotIndex(const std::int64_t position) const
+    {
+        return static_cast<size_t>(static_cast<std::uint64_t>(position) / m_stepSize % m_numEntries);
+    }
+
+    std::byte *slotAt(const std::int64_t position) const { return m_memory.data() + slotIndex(position) * m_entrySize; }
+
+    Header &headerAt(const std::int64_t position) { return *reinterpret_cast<Header *>(slotAt(position)); }
+
+    Entry entryAt(const std::int64_t position)
+    {
+        auto *slot = slotAt(position);
+        auto &header = *reinterpret_cast<Header *>(slot);
+        slot += Arena::blockSize<Header>(1u);
+        const auto coefficients = std::span(reinterpret_cast<std::complex<F> *>(slot), m_numValues);
+        slot += Arena::blockSize<std::complex<F>>(m_numValues);
+        const auto binSpectrum = std::span(reinterpret_cast<SpectrumValue<F> *>(slot), m_numValues);
+        slot += Arena::blockSize<SpectrumValue<F>>(m_numValues);
+        const auto phases = std::span(reinterpret_cast<F *>(slot), m_numValues);
+        return {coefficients, binSpectrum, phases, header.fundamentalFrequency};
+    }
+
+    size_t m_numValues;
+    size_t m_stepSize;
+    size_t m_entrySize;
+    size_t m_numEntries;
+    detail::MappedMemory m_memory;
+    std::vector<bool> m_isSlotCommitted;
+    size_t m_numHits{0u};
+    size_t m_numMisses{0u};
+};
+
+}    // namespace sw::pitchtool
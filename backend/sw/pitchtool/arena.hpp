@@ -0,0 +1,66 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+
+namespace sw::pitchtool {
+
+/// One cache line aligned heap block, from which cache line aligned spans are carved in order of allocation.
+/// Meant for trivially destructible types only, nothing is ever destructed.
+class Arena
+{
+public:
+    static constexpr size_t alignment{64u};
+
+    /// bytes taken from the arena by allocate<T>(numValues)
+    template<typename T>
+    static constexpr size_t blockSize(const size_t numValues)
+    {
+        return ((numValues * sizeof(T) + alignment - 1u) / alignment) * alignment;
+    }
+
+    /// owns heap memory of given size
+    explicit Arena(const size_t size)
+        : m_heap(static_cast<std::byte *>(::operator new(size, std::align_val_t{alignment})))
+        , m_data(m_heap.get())
+        , m_size(size)
+    {}
+
+    /// works on memory owned by someone else, which has to be aligned and outlive the arena
+    explicit Arena(const std::span<std::byte> storage): m_data(storage.data()), m_size(storage.size())
+    {
+        assert(reinterpret_cast<std::uintptr_t>(m_data) % alignment == 0u);
+    }
+
+    template<typename T>
+    std::span<T> allocate(const size_t numValues, const T &value = T{})
+    {
+        static_assert(std::is_trivially_destructible_v<T> && alignof(T) <= alignment);
+        assert(m_used + blockSize<T>(numValues) <= m_size);
+        auto *values = reinterpret_cast<T *>(m_data + m_used);
+        std::uninitialized_fill_n(values, numValues, value);
+        m_used += blockSize<T>(numValues);
+        return {values, numValues};
+    }
+
+    size_t size() const { return m_size; }
+
+    size_t used() const { return m_used; }
+
+private:
+    struct Deleter
+    {
+        void operator()(std::byte *data) const { ::operator delete(data, std::align_val_t{alignment}); }
+    };
+
+    std::unique_ptr<std::byte[], Deleter> m_heap;
+    std::byte *m_data{nullptr};
+    size_t m_size{0u};
+    size_t m_used{0u};
+};
+
+}    // namespace sw::pitchtool
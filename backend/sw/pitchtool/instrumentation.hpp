@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#include "sw/pitchtool/trace.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+namespace sw::pitchtool::instrumentation {
+
+#ifdef SW_PITCHTOOL_INSTRUMENTATION
+constexpr bool enabled{true};
+#else
+constexpr bool enabled{false};
+#endif
+
+/// Each stage is recorded from one place, per step or per voice, so its durations form one distribution
+enum class Stage : std::uint8_t
+{
+    AnalysisFFT,
+    Spectrum,
+    Fundamental,
+    Shift,                ///< per voice
+    Envelope,             ///< cepstral envelope of the input, shared by all voices
+    FormantsAlignment,    ///< per voice
+    InverseFFT,           ///< per voice
+    OverlapAdd,           ///< per voice
+    Mix,                  ///< of dry signal and voices into the output
+    Step                  ///< one whole processing step, containing all other stages
+};
+
+constexpr auto numStages = 10u;
+/// null terminated, so trace events can refer to them
+constexpr std::array<std::string_view, numStages> stageNames{
+  "Analysis FFT", "Spectrum", "Fundamental", "Shift", "Envelope", "Formants Alignment", "Inverse FFT",
+  "Overlap Add", "Mix", "Step"};
+
+/// Cycle counter where available, nanoseconds of a steady clock otherwise
+inline std::uint64_t ticks()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now().time_since_epoch())
+                                        .count());
+#endif
+}
+
+/// durations in ticks
+struct Statistics
+{
+    std::uint64_t min{0u};
+    std::uint64_t mean{0u};
+    std::uint64_t p99{0u};
+    size_t count{0u};    ///< number of durations statistics are taken from
+};
+
+/// The latest durations of one stage. Pushed from one thread, readable from any other without locking.
+class RollingRecord
+{
+public:
+    static constexpr size_t capacity{1024u};
+
+    void push(const std::uint64_t duration)
+    {
+        const auto index = m_numPushed.load(std::memory_order_relaxed);
+        m_durations[index % capacity].store(duration, std::memory_order_relaxed);
+        m_numPushed.store(index + 1u, std::memory_order_release);
+    }
+
+    /// allocates, not meant to be called from the audio thread
+    Statistics statistics() const
+    {
+        const auto numPushed = m_numPushed.load(std::memory_order_acquire);
+        const auto count = static_cast<size_t>(std::min<std::uint64_t>(numPushed, capacity));
+        if (count == 0u)
+            return {};
+
+        std::vector<std::uint64_t> durations(count);
+        std::transform(m_durations.begin(), m_durations.begin() + static_cast<int>(count), durations.begin(),
+                       [](const auto &duration) { return duration.load(std::memory_order_relaxed); });
+
+        const auto p99Index = (count * 99u) / 100u;
+        std::nth_element(durations.begin(), durations.begin() + static_cast<int>(p99Index), durations.end());
+        const auto p99 = durations[p99Index];
+        return {*std::min_element(durations.begin(), durations.end()),
+                std::accumulate(durations.begin(), durations.end(), std::uint64_t{0u}) / count, p99, count};
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, capacity> m_durations{};
+    std::atomic<std::uint64_t> m_numPushed{0u};
+};
+
+template<bool Enabled = enabled || trace::enabled>
+class Recorder;
+
+/// Records stage durations if instrumentation is enabled and trace events if tracing is enabled and a ring is set
+template<>
+class Recorder<true>
+{
+public:
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(RollingRecord &record, trace::Ring *traceRing, const std::string_view name)
+            : m_record(record)
+            , m_trace(traceRing, name.data())
+            , m_start(ticks())
+        {
+        }
+        ScopedTimer(const ScopedTimer &) = delete;
+        ~ScopedTimer()
+        {
+            if constexpr (enabled)
+                m_record.push(ticks() - m_start);
+        }
+
+    private:
+        RollingRecord &m_record;
+        trace::Scope m_trace;
+        std::uint64_t m_start;
+    };
+
+    /// records the time until the returned timer goes out of scope
+    [[nodiscard]] ScopedTimer scoped(const Stage stage)
+    {
+        const auto index = static_cast<size_t>(stage);
+        return ScopedTimer(m_records[index], trace::enabled ? m_traceRing : nullptr, stageNames[index]);
+    }
+
+    Statistics statistics(const Stage stage) const { return m_records[static_cast<size_t>(stage)].statistics(); }
+
+    /// not thread safe, set before processing or from the processing thread only
+    void setTraceRing(trace::Ring *traceRing) { m_traceRing = traceRing; }
+
+private:
+    std::array<RollingRecord, numStages> m_records;
+    trace::Ring *m_traceRing{nullptr};
+};
+
+/// Everything compiles to nothing if instrumentation and tracing are disabled
+template<>
+class Recorder<false>
+{
+public:
+    struct ScopedTimer
+    {
+        ~ScopedTimer() {}    // user provided, so unused timers do not trigger unused variable warnings
+    };
+
+    [[nodiscard]] ScopedTimer scoped(Stage) { return {}; }
+
+    Statistics statistics(Stage) const { return {}; }
+
+    void setTraceRing(trace::Ring *) {}
+};
+
+}    // namespace sw::pitchtool::instrumentation
@@ -1,4 +1,9 @@
 #pragma once
+#include "sw/pitchtool/analysis.hpp"
+#include "sw/pitchtool/analysiscache.hpp"
+#include "sw/pitchtool/instrumentation.hpp"
+#include "sw/pitchtool/quality.hpp"
+#include "sw/pitchtool/tables.hpp"
 #include "sw/pitchtool/types.hpp"
 #include <sw/containers/utils.hpp>
 #include <sw/dft/spectrum.hpp>
@@ -10,21 +15,36 @@
 #include <sw/signals.hpp>
 #include <sw/variant.hpp>
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <cstring>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace sw::pitchtool {
 
 namespace detail {
 
-template<std::floating_point F>
-void toFilteredSpectrum(std::vector<SpectrumValue<F>> &binSpectrum, std::vector<SpectrumValue<F>> &o_spectrum)
+/// shifts buffer content to the front by the number of values and appends these at the end
+template<typename T, std::ranges::sized_range R>
+void ringPush(const std::span<T> io_buffer, R &&values)
+{
+    const auto numValues = static_cast<int>(std::ranges::size(values));
+    assert(numValues <= std::ranges::ssize(io_buffer));
+    std::shift_left(io_buffer.begin(), io_buffer.end(), numValues);
+    std::ranges::copy(values, io_buffer.end() - numValues);
+}
+
+template<typename T>
+void ringPush(const std::span<T> io_buffer, const T value, const size_t count)
 {
-    o_spectrum.clear();
-    std::copy_if(binSpectrum.begin() + 1, binSpectrum.end(), std::back_inserter(o_spectrum),
-                 [zeroGainThresholdLinear = dBToFactor(static_cast<F>(-60))](const auto &value) {
-                     return value.gain > zeroGainThresholdLinear;
-                 });
-    identifyFrequencies(o_spectrum);
+    assert(count <= io_buffer.size());
+    std::shift_left(io_buffer.begin(), io_buffer.end(), static_cast<int>(count));
+    std::fill(io_buffer.end() - static_cast<int>(count), io_buffer.end(), value);
 }
 
 template<std::floating_point F>
@@ -65,11 +85,16 @@ F tuningFactor(const TuningParameters<F> &tuningParameters, const tuning::Type &
       type);
 }
 
-template<std::floating_point F>
-void shiftPitch(const ChannelState<F> &inputState, const F pitchFactor, const F sampleRate, const F timeDiff,
-                ChannelState<F> &io_state)
+/// NumValues can be given if the spectrum size is known at compile time.
+/// Source bins with gains below gainThreshold are skipped, which saves work for sparse spectra.
+/// Only target bins within binRange are shifted, the others are copied from the input.
+template<std::floating_point F, size_t NumValues = std::dynamic_extent>
+void shiftPitch(const SpectralState<F> &inputState, const F pitchFactor, const F sampleRate, const F timeDiff,
+                SpectralState<F> &io_state, const F gainThreshold = math::zero<F>, const BinRange binRange = {})
 {
-    const auto numValues = static_cast<int>(std::ranges::ssize(io_state.binSpectrum));
+    const auto numValues = NumValues == std::dynamic_extent ?
+                             static_cast<int>(std::ranges::ssize(io_state.binSpectrum)) :
+                             static_cast<int>(NumValues);
     assert(std::ranges::ssize(io_state.binSpectrum) == numValues);
     assert(std::ranges::ssize(inputState.binSpectrum) == numValues);
     assert(std::ranges::ssize(io_state.coefficients) == numValues);
@@ -100,6 +125,8 @@ void shiftPitch(const ChannelState<F> &inputState, const F pitchFactor, const F
         for (size_t sourceIndex = range.front(); sourceIndex < range.back(); ++sourceIndex)
         {
             const auto sourceGain = inputState.binSpectrum[sourceIndex].gain;
+            if (sourceGain < gainThreshold)
+                continue;
             const auto frequency = pitchFactor * inputState.binSpectrum[sourceIndex].frequency;
             c +=
               shiftedCoefficient(io_state.phases[targetIndex], inputState.phases[sourceIndex], frequency, sourceGain);
@@ -107,9 +134,21 @@ void shiftPitch(const ChannelState<F> &inputState, const F pitchFactor, const F
         return c;
     };
 
+    const auto endIndex = static_cast<int>(std::min(binRange.end, static_cast<size_t>(numValues)));
+    const auto beginIndex = std::min(static_cast<int>(binRange.begin), endIndex);
+    const auto copyInput = [&](const int begin, const int end) {
+        std::copy(inputState.coefficients.begin() + begin, inputState.coefficients.begin() + end,
+                  io_state.coefficients.begin() + begin);
+        std::copy(inputState.binSpectrum.begin() + begin, inputState.binSpectrum.begin() + end,
+                  io_state.binSpectrum.begin() + begin);
+        std::copy(inputState.phases.begin() + begin, inputState.phases.begin() + end, io_state.phases.begin() + begin);
+    };
+    copyInput(0, beginIndex);
+    copyInput(endIndex, numValues);
+
     const auto gainFactor = static_cast<F>(numValues - 1);
     const auto binFrequencyStep = dft::binFrequencyStep(dft::signalLength(numValues), sampleRate);
-    for (auto targetIndex = 0; targetIndex < numValues; ++targetIndex)
+    for (auto targetIndex = beginIndex; targetIndex < endIndex; ++targetIndex)
     {
         const auto coefficient = accumulatedCoefficient(targetIndex);
         const auto lastPhase = io_state.phases[targetIndex];
@@ -131,32 +170,197 @@ void shiftPitch(const ChannelState<F> &inputState, const F pitchFactor, const F
         io_c.imag(math::zero<F>);    // to make imag part really zero, also after formants filter
     };
 
-    rotate(io_state.coefficients.front(), io_state.phases.front());
-    rotate(io_state.coefficients.back(), io_state.phases.back());
+    if (beginIndex == 0)
+        rotate(io_state.coefficients.front(), io_state.phases.front());
+    if (endIndex == numValues)
+        rotate(io_state.coefficients.back(), io_state.phases.back());
 }
 
-}    // namespace detail
+/// Cepstrally smoothed log gains of binSpectrum. Uses the (even) log spectrum as signal for a forward transform,
+/// cuts off quefrencies from lifterLength on, and transforms back.
+template<std::floating_point F>
+void toLogEnvelope(const std::span<const SpectrumValue<F>> binSpectrum, const size_t lifterLength,
+                   const F fftRoundTripFactor, sw::dft::FFT<F> &fft, const std::span<F> io_signal,
+                   const std::span<std::complex<F>> io_cepstrum, const std::span<F> o_logEnvelope)
+{
+    const auto numValues = binSpectrum.size();
+    assert(io_signal.size() == dft::signalLength(numValues));
+    assert(io_cepstrum.size() == numValues && o_logEnvelope.size() == numValues);
+
+    const auto gainThreshold = dBToFactor(static_cast<F>(-90));
+    const auto logGain = [gainThreshold](const auto &value) { return std::log(std::max(value.gain, gainThreshold)); };
+
+    std::transform(binSpectrum.begin(), binSpectrum.end(), io_signal.begin(), logGain);
+    std::transform(binSpectrum.begin() + 1, binSpectrum.end() - 1, io_signal.rbegin(), logGain);
+
+    fft.transform(io_signal, io_cepstrum);
+    std::fill(io_cepstrum.begin() + static_cast<int>(std::min(lifterLength, numValues)), io_cepstrum.end(),
+              std::complex<F>{math::zero<F>});
+    fft.transform_inverse(io_cepstrum, io_signal);
+
+    std::transform(io_signal.begin(), io_signal.begin() + static_cast<int>(numValues), o_logEnvelope.begin(),
+                   [factor = math::one<F> / fftRoundTripFactor](const auto s) { return factor * s; });
+}
+
+/// Factors moving the envelope of a spectrum shifted by pitchFactor to the input envelope shifted by formantsFactor,
+/// one outside binRange
+template<std::floating_point F>
+void warpedEnvelopeFactors(const std::span<const F> logEnvelope, const F pitchFactor, const F formantsFactor,
+                           const std::span<F> o_factors, const BinRange binRange = {})
+{
+    assert(o_factors.size() == logEnvelope.size());
+
+    const auto lastIndex = logEnvelope.size() - 1u;
+    const auto interpolated = [&](const F index) {
+        const auto clampedIndex = std::min(index, static_cast<F>(lastIndex));
+        const auto lowerIndex = static_cast<size_t>(clampedIndex);
+        const auto upperIndex = std::min(lowerIndex + 1u, lastIndex);
+        const auto t = clampedIndex - static_cast<F>(lowerIndex);
+        return (math::one<F> - t) * logEnvelope[lowerIndex] + t * logEnvelope[upperIndex];
+    };
+
+    const auto endIndex = std::min(binRange.end, o_factors.size());
+    const auto beginIndex = std::min(binRange.begin, endIndex);
+    std::fill(o_factors.begin(), o_factors.begin() + static_cast<int>(beginIndex), math::one<F>);
+    std::fill(o_factors.begin() + static_cast<int>(endIndex), o_factors.end(), math::one<F>);
+
+    constexpr auto maxFactor = static_cast<F>(10);
+    for (auto i = beginIndex; i < endIndex; ++i)
+    {
+        const auto index = static_cast<F>(i);
+        o_factors[i] =
+          std::min(maxFactor, std::exp(interpolated(index / formantsFactor) - interpolated(index / pitchFactor)));
+    }
+}
+
+/// mix moved towards target by at most step
+template<std::floating_point F>
+F faded(const F mix, const F target, const F step)
+{
+    return target > mix ? std::min(target, mix + step) : std::max(target, mix - step);
+}
+
+template<std::floating_point F>
+struct FormantsAlignment
+{
+    F pitchFactor{math::one<F>};
+    F formantsFactor{math::one<F>};
+    F mix{math::one<F>};    ///< crossfade between no (0) and full (1) alignment
+    const SpectralState<F> *shiftedState{nullptr};    ///< only set for formants::Mode::Shift
+
+    bool needed() const { return !math::equal(pitchFactor, formantsFactor) && !math::isZero(mix); }
+};
+
+template<std::floating_point F>
+void copyShiftedSpectrum(const SpectralState<F> &source, SpectralState<F> &o_target)
+{
+    std::ranges::copy(source.coefficients, o_target.coefficients.begin());
+    std::ranges::copy(source.binSpectrum, o_target.binSpectrum.begin());
+    std::ranges::copy(source.phases, o_target.phases.begin());
+    o_target.phaseHistory = source.phaseHistory;
+}
+
+inline std::uint64_t combinedHash(const std::uint64_t seed, const std::uint64_t value)
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6u) + (seed >> 2u));
+}
+
+/// Identifies the analysed phases of step
+inline std::uint64_t inputPhaseHistory(const std::uint64_t step)
+{
+    return combinedHash(0x1u, step);
+}
+
+/// Identifies the phases shifted by factor in step, from the phases identified by previous. Within one step,
+/// shifting only depends on these and the input state, so equal values mean equal phases.
+template<std::floating_point F>
+std::uint64_t shiftedPhaseHistory(const std::uint64_t previous, const F factor, const std::uint64_t step)
+{
+    using Bits = std::conditional_t<sizeof(F) == 8u, std::uint64_t, std::uint32_t>;
+    return combinedHash(combinedHash(previous, static_cast<std::uint64_t>(std::bit_cast<Bits>(factor))), step);
+}
+
+/// Remembers the states pitch shifted within one processing step, so equal shift factors are computed only once.
+/// Shifting continues the phases of the shifted state, so an entry only fits states with the phase history it was
+/// shifted from. Entries that are not stable (synthesis states, which get modified after shifting) are only handed
+/// out for copying.
+template<std::floating_point F, size_t Capacity>
+class ShiftMemo
+{
+public:
+    struct Entry
+    {
+        F factor{math::one<F>};
+        std::uint64_t previousPhaseHistory{0u};
+        const SpectralState<F> *state{nullptr};
+        bool stable{false};
+    };
+
+    void clear() { m_size = 0u; }
+
+    /// Cleared states were silent, so they can take over any phases
+    Entry *find(const F factor, const std::uint64_t phaseHistory)
+    {
+        const auto end = m_entries.begin() + static_cast<int>(m_size);
+        const auto it = std::find_if(m_entries.begin(), end, [&](const auto &entry) {
+            return math::equal(entry.factor, factor) &&
+                   (phaseHistory == 0u || entry.previousPhaseHistory == phaseHistory);
+        });
+        return it == end ? nullptr : &(*it);
+    }
+
+    void add(const F factor, const std::uint64_t previousPhaseHistory, const SpectralState<F> &state,
+             const bool stable)
+    {
+        assert(m_size < Capacity);
+        m_entries[m_size++] = {factor, previousPhaseHistory, &state, stable};
+    }
+
+private:
+    std::array<Entry, Capacity> m_entries;
+    size_t m_size{0u};
+};
 
 template<std::floating_point F, std::uint8_t NumChannels>
+constexpr size_t processorArenaSize(const size_t fftLength)
+{
+    const auto numValues = nyquistLength(fftLength);
+    return Arena::blockSize<F>(fftLength) + AnalysisState<F>::arenaSize(fftLength) +
+           NumChannels * VoiceState<F>::arenaSize(fftLength) + 2u * Arena::blockSize<F>(numValues) +
+           Arena::blockSize<std::complex<F>>(numValues);
+}
+
+/// With dynamic sizes, the arena allocates on the heap
+template<std::floating_point F, std::uint8_t NumChannels, typename Sizes>
+struct ArenaStorage
+{
+    Arena makeArena(const Sizes &sizes) { return Arena(processorArenaSize<F, NumChannels>(sizes.fftLength())); }
+};
+
+/// With fixed sizes, the arena works on storage inside the processor
+template<std::floating_point F, std::uint8_t NumChannels, size_t FftLength, size_t OverSampling>
+struct ArenaStorage<F, NumChannels, sizes::Fixed<FftLength, OverSampling>>
+{
+    Arena makeArena(const sizes::Fixed<FftLength, OverSampling> &) { return Arena(std::span<std::byte>(bytes)); }
+
+    alignas(Arena::alignment) std::array<std::byte, processorArenaSize<F, NumChannels>(FftLength)> bytes;
+};
+
+}    // namespace detail
+
+template<std::floating_point F, std::uint8_t NumChannels, typename Sizes = sizes::Dynamic>
 class Processor
 {
 public:
     Processor(const size_t fftLength, const size_t overSampling)
-        : m_fftLength(fftLength)
-        , m_overSampling(overSampling)
-        , m_fft(fftLength)
-        , m_inputState(fftLength)
-        , m_channelStates(
-            containers::makeArray<NumChannels>([fftLength](const size_t) { return ChannelState<F>(fftLength); }))
-        , m_formantsStates(
-            containers::makeArray<NumChannels>([fftLength](const size_t) { return ChannelState<F>(fftLength); }))
-        , m_signalWindow(makeVonHannWindow<F>(fftLength))
-        , tmp_processingSignal(fftLength, math::zero<F>)
-        , tmp_envelopeAlignmentFactors(dft::nyquistLength(fftLength), math::one<F>)
-    {
-        assert(overSampling > 1u && overSampling * overSampling < fftLength &&
-               fftLength == (fftLength / overSampling) * overSampling);
-    }
+        requires std::same_as<Sizes, sizes::Dynamic>
+        : Processor(Sizes(fftLength, overSampling))
+    {}
+
+    Processor()
+        requires(!std::same_as<Sizes, sizes::Dynamic>)
+        : Processor(Sizes{})
+    {}
 
     template<ranges::TypedInputRange<F> InSignal, ranges::TypedOutputRange<F> OutSignal>
     void process(InSignal &&signal, OutSignal &&o_signal, const F sampleRate,
@@ -169,46 +373,206 @@ public:
         assert(std::ranges::ssize(signal) == stepSize);
         assert(std::ranges::ssize(o_signal) == stepSize);
 
-        {    // update input state
-            containers::ringPush(m_inputState.accumulator, signal);
+        const auto stepTimer = m_instrumentation.scoped(instrumentation::Stage::Step);
+
+        tmp_binRange = detail::toBinRange(m_band, m_inputState.binSpectrum.size(), sampleRate);
+        ++m_numSteps;
 
-            std::transform(m_signalWindow.begin(), m_signalWindow.end(),
-                           m_inputState.accumulator.end() - static_cast<int>(m_fftLength), tmp_processingSignal.begin(),
-                           std::multiplies());
+        // the first analysis after skipped ones only refreshes phases, bin frequencies need the previous step's
+        auto isPhaseRefresh = false;
+        {    // update input state
+            m_inputState.phaseHistory = detail::inputPhaseHistory(m_numSteps);
+            // with look ahead, detection sees the input lookAheadSteps steps before analysis and synthesis do
+            std::span<const F> detectionSignal;
+            if (m_lookAheadSteps > 0u)
+            {
+                detail::ringPush(std::span(m_lookAheadSignal), signal);
+                detail::ringPush(m_inputState.accumulator,
+                                 std::span<const F>(m_lookAheadSignal).first(static_cast<size_t>(stepSize)));
+                detectionSignal = std::span<const F>(m_lookAheadSignal).last(static_cast<size_t>(stepSize));
+            }
+            else
+            {
+                detail::ringPush(m_inputState.accumulator, signal);
+                detectionSignal = std::span<const F>(m_inputState.accumulator).last(static_cast<size_t>(stepSize));
+            }
 
-            m_fft.transform(tmp_processingSignal, m_inputState.coefficients);
+            // with decimated detection, the full analysis spectrum is needed for audible or requested voices and
+            // displays only
+            const auto isSpectrumNeeded =
+              m_detectionMode == detection::Mode::Spectrum || m_isSpectrumRequested.load(std::memory_order_relaxed) ||
+              std::ranges::any_of(std::views::iota(0u, static_cast<unsigned>(NumChannels)), [&](const auto i) {
+                  return !math::isZero(channelParameters[i].mixGain) || m_isVoiceSignalRequested[i];
+              });
+
+            // a step analysed before at the same timeline position, from the same input, is taken from the cache
+            std::optional<typename AnalysisCache<F>::Entry> cacheEntry;
+            const auto isCacheHit = lookUpAnalysis(sampleRate, cacheEntry);
+            std::optional<F> detectedFrequency;
+            isPhaseRefresh = !isCacheHit && isSpectrumNeeded && m_isPhasesStale;
+            m_isPhasesStale = !isCacheHit && !isSpectrumNeeded;
+
+            if (isCacheHit)
+            {
+                const auto timer = m_instrumentation.scoped(instrumentation::Stage::Spectrum);
+                std::ranges::copy(cacheEntry->coefficients, m_inputState.coefficients.begin());
+                std::ranges::copy(cacheEntry->binSpectrum, m_inputState.binSpectrum.begin());
+                std::ranges::copy(cacheEntry->phases, m_inputState.phases.begin());
+                if (cacheEntry->fundamentalFrequency >= math::zero<F>)
+                    detectedFrequency = cacheEntry->fundamentalFrequency;
+            }
+            else if (isSpectrumNeeded)
+            {
+                {
+                    const auto timer = m_instrumentation.scoped(instrumentation::Stage::AnalysisFFT);
+                    std::transform(m_tables->window.begin(), m_tables->window.begin() + static_cast<int>(fftLength()),
+                                   m_inputState.accumulator.begin(), tmp_processingSignal.begin(),
+                                   std::multiplies());
+                    m_fft.transform(tmp_processingSignal, m_inputState.coefficients);
+                }
 
-            dft::toSpectrumByPhase<F>(sampleRate, timeDiff, m_inputState.phases, m_inputState.coefficients,
-                                      m_inputState.binSpectrum, m_inputState.phases);
+                const auto timer = m_instrumentation.scoped(instrumentation::Stage::Spectrum);
+                dft::toSpectrumByPhase<F>(sampleRate, timeDiff, m_inputState.phases, m_inputState.coefficients,
+                                          m_inputState.binSpectrum, m_inputState.phases);
+            }
 
-            detail::toFilteredSpectrum(m_inputState.binSpectrum, m_inputState.spectrumSwap.inSwap());
+            m_timeSinceDetection += timeDiff;
+            if (detectedFrequency)
+            {
+                const auto timer = m_instrumentation.scoped(instrumentation::Stage::Fundamental);
+                m_inputState.fundamentalFrequency =
+                  m_frequencyEnvelope.process(*detectedFrequency, m_timeSinceDetection, tuningParameters.averagingTime,
+                                              tuningParameters.holdTime);
+                m_timeSinceDetection = math::zero<F>;
+                m_isDetectionSkipped = false;
+
+                if (m_isSpectrumRequested.load(std::memory_order_relaxed) && !m_inputState.spectrumBuffer.isPending())
+                {
+                    detail::toFilteredSpectrum<F>(m_inputState.binSpectrum, m_inputState.spectrumBuffer.inBuffer(),
+                                                  tmp_binRange);
+                    m_inputState.pushSpectrum();
+                }
+            }
+            else if (m_lookAheadSteps > 0u || m_detectionMode == detection::Mode::Decimated)
+            {    // spectrum detection would see the delayed analysis only, so look ahead detects decimated
+                {
+                    const auto timer = m_instrumentation.scoped(instrumentation::Stage::Fundamental);
+                    const auto frequency = m_pitchDetector.process(detectionSignal, sampleRate, m_band);
+                    if (m_lookAheadSteps > 0u)
+                    {
+                        m_inputState.fundamentalFrequency =
+                          m_frequencyEnvelope.process(settledFrequency(frequency), timeDiff,
+                                                      tuningParameters.averagingTime, tuningParameters.holdTime);
+                        m_timeSinceDetection = math::zero<F>;
+                    }
+                    else if (frequency)
+                    {
+                        m_inputState.fundamentalFrequency =
+                          m_frequencyEnvelope.process(*frequency, m_timeSinceDetection, tuningParameters.averagingTime,
+                                                      tuningParameters.holdTime);
+                        m_timeSinceDetection = math::zero<F>;
+                    }
+                }
 
-            const auto squaredGainsThreshold =
-              static_cast<F>(0.3) *
-              ranges::accumulate<F>(gains<F>(m_inputState.binSpectrum) |
-                                    std::views::transform([](const auto gain) { return gain * gain; }));
+                // only displays need the filtered spectrum, which is not published again before they took the last one
+                if (isSpectrumNeeded && !m_inputState.spectrumBuffer.isPending())
+                {
+                    detail::toFilteredSpectrum<F>(m_inputState.binSpectrum, m_inputState.spectrumBuffer.inBuffer(),
+                                                  tmp_binRange);
+                    m_inputState.pushSpectrum();
+                }
+            }
+            else if (m_qualityLevel < quality::Level::ReducedDetection || std::exchange(m_isDetectionSkipped, false))
+            {
+                const auto timer = m_instrumentation.scoped(instrumentation::Stage::Fundamental);
+                detail::toFilteredSpectrum<F>(m_inputState.binSpectrum, m_inputState.spectrumBuffer.inBuffer(),
+                                              tmp_binRange);
+
+                const auto bandSpectrum = std::span(m_inputState.binSpectrum)
+                                            .subspan(tmp_binRange.begin, tmp_binRange.end - tmp_binRange.begin);
+                const auto squaredGainsThreshold =
+                  static_cast<F>(0.3) *
+                  ranges::accumulate<F>(gains<F>(bandSpectrum) |
+                                        std::views::transform([](const auto gain) { return gain * gain; }));
+
+                detectedFrequency =
+                  findFundamental<F>(m_inputState.spectrumBuffer.inBuffer(), squaredGainsThreshold).frequency;
+                m_inputState.fundamentalFrequency = m_frequencyEnvelope.process(
+                  *detectedFrequency, m_timeSinceDetection, tuningParameters.averagingTime, tuningParameters.holdTime);
+                m_timeSinceDetection = math::zero<F>;
+
+                m_inputState.pushSpectrum();
+            }
+            else
+            {
+                m_isDetectionSkipped = true;
+            }
 
-            m_inputState.fundamentalFrequency = m_frequencyEnvelope.process(
-              findFundamental<F>(m_inputState.spectrumSwap.inSwap(), squaredGainsThreshold).frequency, timeDiff,
-              tuningParameters.averagingTime, tuningParameters.holdTime);
+            if (cacheEntry && !isCacheHit)
+            {
+                std::ranges::copy(m_inputState.coefficients, cacheEntry->coefficients.begin());
+                std::ranges::copy(m_inputState.binSpectrum, cacheEntry->binSpectrum.begin());
+                std::ranges::copy(m_inputState.phases, cacheEntry->phases.begin());
+                cacheEntry->fundamentalFrequency = detectedFrequency.value_or(-math::one<F>);
+            }
 
-            m_inputState.spectrumSwap.push();
+            // the threshold fades in and out like formants alignment, so skipping peaks cannot be heard switching
+            const auto sparsePeaksMixTarget =
+              m_qualityLevel >= quality::Level::SparsePeaks ? math::one<F> : math::zero<F>;
+            m_sparsePeaksMix = detail::faded(m_sparsePeaksMix, sparsePeaksMixTarget, timeDiff / m_fadeTime);
+            m_sparseGainThreshold = math::zero<F>;
+            if (isSpectrumNeeded && !math::isZero(m_sparsePeaksMix))
+            {
+                m_sparseGainThreshold = m_sparsePeaksMix * dBToFactor(static_cast<F>(-60)) *
+                                        std::ranges::max(gains<F>(m_inputState.binSpectrum));
+            }
         }
 
         {    // process channels
+            // all shifts happen before any channel state is modified, so memoized results can be shared
+            m_shiftMemo.clear();
+            const auto alignmentMixTarget =
+              m_qualityLevel < quality::Level::NoFormantsAlignment ? math::one<F> : math::zero<F>;
+            // voices stay silent for a phase refresh and start over from the refreshed phases in the next step,
+            // mix gains only apply to the mix, so requested voices are synthesized at zero mix gain as well
+            const auto isActive = [&](const auto i) {
+                return !isPhaseRefresh && (!math::isZero(channelParameters[i].mixGain) || m_isVoiceSignalRequested[i]);
+            };
             for (auto i = 0u; i < NumChannels; ++i)
             {
-                processChannel(channelParameters[i], tuningParameters, sampleRate, timeDiff, stepSize,
-                               m_channelStates[i], m_formantsStates[i]);
+                const auto timer = m_instrumentation.scoped(instrumentation::Stage::Shift);
+                m_alignmentMixes[i] = detail::faded(m_alignmentMixes[i], alignmentMixTarget, timeDiff / m_fadeTime);
+                tmp_formantsAlignments[i] =
+                  shiftChannel(channelParameters[i], isActive(i), tuningParameters, sampleRate, timeDiff,
+                               m_alignmentMixes[i], m_voiceStates[i].synthesis, m_voiceStates[i].formants);
+            }
+
+            if (m_formantsMode == formants::Mode::Envelope &&
+                std::ranges::any_of(std::views::iota(0u, static_cast<unsigned>(NumChannels)), [&](const auto i) {
+                    return isActive(i) && tmp_formantsAlignments[i].needed();
+                }))
+            {
+                const auto timer = m_instrumentation.scoped(instrumentation::Stage::Envelope);
+                const auto lifterLength =
+                  static_cast<size_t>(std::max(static_cast<F>(2), std::round(m_envelopeLifterTime * sampleRate)));
+                detail::toLogEnvelope<F>(m_inputState.binSpectrum, lifterLength, m_tables->fftRoundTripFactor, m_fft,
+                                         tmp_processingSignal, tmp_cepstrum, tmp_logEnvelope);
+            }
+
+            for (auto i = 0u; i < NumChannels; ++i)
+            {
+                if (isActive(i))
+                    processChannel(tmp_formantsAlignments[i], stepSize, m_voiceStates[i].synthesis);
             }
         }
 
         {    // fill output
+            const auto timer = m_instrumentation.scoped(instrumentation::Stage::Mix);
             std::transform(m_inputState.accumulator.begin(), m_inputState.accumulator.begin() + stepSize,
                            o_signal.begin(), [dryMixGain](const auto sample) { return dryMixGain * sample; });
             for (auto i = 0u; i < NumChannels; ++i)
             {
-                auto &channelState = m_channelStates[i];
+                auto &channelState = m_voiceStates[i].synthesis;
                 const auto mixGain = channelParameters[i].mixGain;
                 if (!math::isZero(mixGain))
                 {
@@ -228,49 +592,297 @@ public:
         assert(static_cast<int>(std::ranges::ssize(signal)) == stepSize);
         assert(static_cast<int>(std::ranges::ssize(o_signal)) == stepSize);
 
-        containers::ringPush(m_inputState.accumulator, signal);
+        detail::ringPush(m_inputState.accumulator, signal);
         m_inputState.fundamentalFrequency = math::zero<F>;
-        m_inputState.spectrumSwap.inSwap().clear();
-        m_inputState.spectrumSwap.push();
+        m_inputState.clearSpectrum();
+        m_windowHash = 0u;    // phases are not analysed, the next step cannot continue a cached one
+        m_isPhasesStale = true;
 
-        for (auto i = 0; i < NumChannels; ++i)
+        for (auto &voiceState : m_voiceStates)
         {
-            m_channelStates[i].clear();
-            m_formantsStates[i].clear();
+            voiceState.synthesis.clear();
+            voiceState.formants.clear();
         }
 
         std::copy(m_inputState.accumulator.begin(), m_inputState.accumulator.begin() + stepSize, o_signal.begin());
     }
 
-    size_t fftLength() const { return m_fftLength; }
+    /// Processes numSteps steps of a test signal with all voices shifting pitch and formants, so lazily initialized
+    /// internals, caches and branch predictors are warm before the first real step. Resets all state afterwards.
+    /// Allocates, not meant for the audio thread.
+    void prime(const F sampleRate, const size_t numSteps)
+    {
+        const auto signal =
+          makeSineWave<F>(math::oneHalf<F>, static_cast<F>(220), sampleRate, static_cast<unsigned>(stepSize()));
+        std::vector<F> outSignal(stepSize());
+        const auto channelParameters = containers::makeArray<NumChannels>([](const size_t channel) {
+            return ChannelParameters<F>{.pitchShift = static_cast<F>(channel + 1u),
+                                        .formantsShift = math::oneHalf<F>,
+                                        .mixGain = math::oneHalf<F>};
+        });
+        for (auto i = 0u; i < numSteps; ++i)
+            process(signal, outSignal, sampleRate, TuningParameters<F>{}, channelParameters, math::oneHalf<F>);
+        reset();
+    }
 
-    size_t overSampling() const { return m_overSampling; }
+    /// Back to the state after construction, keeping modes and quality level
+    void reset()
+    {
+        m_inputState.clear();
+        for (auto &voiceState : m_voiceStates)
+        {
+            voiceState.synthesis.clear();
+            voiceState.synthesis.tuningEnvelope = TuningNoteEnvelope<F>{};
+            voiceState.formants.clear();
+        }
+        m_frequencyEnvelope = FrequencyEnvelope<F>{100u};
+        std::ranges::fill(m_alignmentMixes, math::one<F>);
+        m_sparsePeaksMix = m_qualityLevel >= quality::Level::SparsePeaks ? math::one<F> : math::zero<F>;
+        m_timeSinceDetection = math::zero<F>;
+        m_isDetectionSkipped = false;
+        m_isPhasesStale = false;
+        std::ranges::fill(m_lookAheadSignal, math::zero<F>);
+        std::ranges::fill(m_lookAheadFrequencies, math::zero<F>);
+        m_cachePosition.reset();
+        m_windowHash = 0u;
+        m_numSteps = 0u;
+    }
 
-    size_t stepSize() const { return m_fftLength / m_overSampling; }
+    /// The latest fftLength input samples, e.g. to warm up another processor
+    std::span<const F> inputHistory() const { return m_inputState.accumulator; }
 
-    size_t overlapSize() const { return m_fftLength - stepSize(); }
+    /// Fills the input window with the end of history, so a new processor analyses a full window from its first step.
+    /// With look ahead, the latest samples of history fill the look ahead instead.
+    void warmUp(const std::span<const F> history)
+    {
+        const auto numAhead = std::min(history.size(), m_lookAheadSignal.size());
+        const auto behind = history.first(history.size() - numAhead);
+        detail::ringPush(m_inputState.accumulator,
+                         behind.last(std::min(behind.size(), m_inputState.accumulator.size())));
+        detail::ringPush(std::span(m_lookAheadSignal), history.last(numAhead));
+        m_windowHash = 0u;
+    }
+
+    /// Pitch detection runs numSteps steps ahead of analysis and synthesis, which adds numSteps * stepSize() samples
+    /// of latency. The fundamental frequency of a step is settled by the median of the detections numSteps steps
+    /// around it, so single wrong detections, e.g. at note onsets or octave errors, do not reach the tuning. Spectrum
+    /// detection needs the analysis of the delayed step, so look ahead detects decimated in either mode.
+    /// Resets the input state. Allocates, not meant for the audio thread.
+    void setLookAhead(const size_t numSteps)
+    {
+        m_lookAheadSteps = numSteps;
+        m_lookAheadSignal.assign(numSteps > 0u ? (numSteps + 1u) * stepSize() : 0u, math::zero<F>);
+        m_lookAheadFrequencies.assign(numSteps > 0u ? 2u * numSteps + 1u : 0u, math::zero<F>);
+        tmp_sortedFrequencies.assign(m_lookAheadFrequencies.size(), math::zero<F>);
+        reset();
+    }
+
+    size_t lookAheadSteps() const { return m_lookAheadSteps; }
+
+    /// added latency of look ahead in samples
+    size_t lookAheadSize() const { return m_lookAheadSteps * stepSize(); }
+
+    /// Steps with a timeline position look their analysis up in cache and store it there if not found. Only used
+    /// with spectrum detection and without look ahead. The cache has to be made for the sizes of this processor and
+    /// outlive its use, nullptr disables caching.
+    void setAnalysisCache(AnalysisCache<F> *cache) { m_analysisCache = cache; }
+
+    /// Position on the host timeline of the next step, in samples at the processing rate. Applies to that step only,
+    /// steps without a position, e.g. while the host is stopped, do not use the analysis cache.
+    void setCachePosition(const std::optional<std::int64_t> position) { m_cachePosition = position; }
+
+    size_t fftLength() const { return m_sizes.fftLength(); }
+
+    size_t overSampling() const { return m_sizes.overSampling(); }
+
+    size_t stepSize() const { return fftLength() / overSampling(); }
 
-    const std::vector<SpectrumValue<F>> &inputSpectrum() const { return m_inputState.spectrumSwap.pull(); }
+    size_t overlapSize() const { return fftLength() - stepSize(); }
+
+    /// Synthesis of one voice in the latest step at unity gain, before mixing. Silent for voices of zero mix gain,
+    /// unless their signal is requested. Valid until the next step.
+    std::span<const F> voiceSignal(const size_t channel) const
+    {
+        return std::span<const F>(m_voiceStates[channel].synthesis.accumulator).first(stepSize());
+    }
+
+    /// Input of the latest step, delayed like the voices, before mixing. Valid until the next step.
+    std::span<const F> drySignal() const { return std::span<const F>(m_inputState.accumulator).first(stepSize()); }
+
+    /// Latest filtered input spectrum, for one reader thread. While a spectrum is not pulled, newer ones are not
+    /// computed, so a reader gets the one of the first step after its previous pull.
+    const std::vector<SpectrumValue<F>> &inputSpectrum() const { return m_inputState.spectrumBuffer.pull(); }
+
+    /// Frame number of the input spectrum of the latest pull, equal numbers mean an unchanged spectrum
+    std::uint64_t inputSpectrumFrame() const { return m_inputState.spectrumBuffer.frame(); }
 
     F inFundamentalFrequency() const { return m_inputState.fundamentalFrequency; }
 
     const std::vector<SpectrumValue<F>> &outputSpectrum(const size_t channel) const
     {
-        return m_channelStates[channel].spectrumSwap.pull();
+        return m_voiceStates[channel].synthesis.spectrumBuffer.pull();
+    }
+
+    std::uint64_t outputSpectrumFrame(const size_t channel) const
+    {
+        return m_voiceStates[channel].synthesis.spectrumBuffer.frame();
+    }
+
+    F outFundamentalFrequency(const size_t channel) const
+    {
+        return m_voiceStates[channel].synthesis.fundamentalFrequency;
     }
 
-    F outFundamentalFrequency(const size_t channel) const { return m_channelStates[channel].fundamentalFrequency; }
+    formants::Mode formantsMode() const { return m_formantsMode; }
+
+    void setFormantsMode(const formants::Mode mode) { m_formantsMode = mode; }
+
+    quality::Level qualityLevel() const { return m_qualityLevel; }
+
+    const Band<F> &band() const { return m_band; }
+
+    detection::Mode detectionMode() const { return m_detectionMode; }
+
+    void setDetectionMode(const detection::Mode mode) { m_detectionMode = mode; }
+
+    /// With decimated detection, the input spectrum is only analysed if a voice or a display needs it.
+    /// Tells whether a display does, can be called from any thread.
+    void setSpectrumRequested(const bool requested) { m_isSpectrumRequested = requested; }
+
+    /// Voices of zero mix gain are not synthesized, unless their signal is requested, e.g. for a separate output.
+    /// Takes effect with the next step.
+    void setVoiceSignalsRequested(const std::array<bool, NumChannels> &requested)
+    {
+        m_isVoiceSignalRequested = requested;
+    }
+
+    /// Takes effect with the next step
+    void setBand(const Band<F> &band) { m_band = band; }
+
+    /// Takes effect with the next step, formants alignment and sparse peaks are crossfaded within fade time
+    void setQualityLevel(const quality::Level level) { m_qualityLevel = level; }
+
+    /// Durations of the latest runs of one processing stage, in ticks of instrumentation::ticks().
+    /// Only available if built with SW_PITCHTOOL_INSTRUMENTATION, otherwise all zero.
+    instrumentation::Statistics stageStatistics(const instrumentation::Stage stage) const
+    {
+        return m_instrumentation.statistics(stage);
+    }
+
+    /// Begin and end events of all stages are pushed to traceRing, nullptr stops tracing.
+    /// Only effective if built with SW_PITCHTOOL_TRACING. Has to be called from the processing thread.
+    void setTraceRing(trace::Ring *traceRing) { m_instrumentation.setTraceRing(traceRing); }
+
+    /// Memory owned by this instance in bytes, internals of the FFT and shared tables not included
+    size_t memoryFootprint() const
+    {
+        // spectrum buffers keep their capacity of nyquistLength values, computed as pulling would race the display
+        const auto spectrumBufferFootprint = 3u * nyquistLength(fftLength()) * sizeof(SpectrumValue<F>);
+        const auto lookAheadFootprint =
+          (m_lookAheadSignal.capacity() + m_lookAheadFrequencies.capacity() + tmp_sortedFrequencies.capacity()) *
+          sizeof(F);
+        return sizeof(*this) + m_arena.size() + m_pitchDetector.memoryFootprint() + lookAheadFootprint +
+               (1u + NumChannels) * spectrumBufferFootprint;
+    }
 
 private:
-    void processChannel(const ChannelParameters<F> &parameters, const TuningParameters<F> &tuningParameters,
-                        const F sampleRate, const F timeDiff, const int stepSize, ChannelState<F> &io_channelState,
-                        ChannelState<F> &io_formantsState)
+    explicit Processor(const Sizes &sizes)
+        : m_sizes(sizes)
+        , m_fft(fftLength())
+        , m_tables(sharedTables<F>(fftLength()))
+        , m_arena(m_storage.makeArena(sizes))
+        , tmp_processingSignal(m_arena.allocate<F>(fftLength(), math::zero<F>))
+        , m_inputState(m_arena, fftLength())
+        , m_voiceStates(
+            containers::makeArray<NumChannels>([&](const size_t) { return VoiceState<F>(m_arena, fftLength()); }))
+        , tmp_envelopeAlignmentFactors(m_arena.allocate<F>(nyquistLength(fftLength()), math::one<F>))
+        , tmp_cepstrum(m_arena.allocate<std::complex<F>>(nyquistLength(fftLength())))
+        , tmp_logEnvelope(m_arena.allocate<F>(nyquistLength(fftLength()), math::zero<F>))
+        , m_pitchDetector(detectionDecimationFactor(), fftLength() / detectionDecimationFactor(),
+                          std::min<size_t>(4u, overSampling()), stepSize())
+    {
+        assert(m_arena.used() == m_arena.size());
+    }
+
+    /// decimated detection keeps the duration of the window, at a resolution still fine for voice fundamentals
+    size_t detectionDecimationFactor() const { return std::clamp<size_t>(fftLength() / 256u, 1u, 8u); }
+
+    /// Hashes the input window and looks the step up in the analysis cache. Returns true if it was found, with its
+    /// entry in o_entry, otherwise o_entry is the entry to store the analysis of this step in, if any. The analysis
+    /// depends on the previous window too, so the first window hashed after a reset is never looked up.
+    bool lookUpAnalysis(const F sampleRate, std::optional<typename AnalysisCache<F>::Entry> &o_entry)
+    {
+        const auto position = std::exchange(m_cachePosition, std::nullopt);
+        const auto previousWindowHash = std::exchange(m_windowHash, 0u);
+        if (m_analysisCache == nullptr || m_detectionMode != detection::Mode::Spectrum || m_lookAheadSteps > 0u)
+            return false;
+
+        // detections are cached before the frequency envelope, which runs for every step
+        const auto settings = std::array{sampleRate, m_band.lowFrequency, m_band.highFrequency};
+        m_windowHash = detail::hashValues<F>(m_inputState.accumulator, detail::hashValues<F>(settings));
+        if (!position || previousWindowHash == 0u)
+            return false;
+
+        if (const auto entry = m_analysisCache->find(*position, m_windowHash, previousWindowHash))
+        {
+            o_entry.emplace(*entry);
+            return true;
+        }
+        if (const auto entry = m_analysisCache->store(*position, m_windowHash, previousWindowHash))
+            o_entry.emplace(*entry);
+        return false;
+    }
+
+    /// Median of the detections around the step analysed now, the latest detection is held between detector hops
+    F settledFrequency(const std::optional<F> detection)
+    {
+        detail::ringPush(std::span(m_lookAheadFrequencies), detection.value_or(m_lookAheadFrequencies.back()), 1u);
+        std::ranges::copy(m_lookAheadFrequencies, tmp_sortedFrequencies.begin());
+        const auto median = tmp_sortedFrequencies.begin() + static_cast<int>(m_lookAheadSteps);
+        std::nth_element(tmp_sortedFrequencies.begin(), median, tmp_sortedFrequencies.end());
+        return *median;
+    }
+
+    /// Pitch shifted input state for factor, either memoized, the input state itself (unity factor), or newly
+    /// shifted into io_state. With stable set, the returned state is guaranteed not to be modified in this step.
+    /// Other states are only returned if io_state continues their phases, or was cleared, so phases of a voice do
+    /// not jump when its factor meets the one of another voice, or unity.
+    const SpectralState<F> &shifted(const F factor, const F sampleRate, const F timeDiff,
+                                    SpectralState<F> &io_state, const bool stable)
+    {
+        const auto phaseHistory = io_state.phaseHistory;
+        if (math::equal(factor, math::one<F>) &&
+            (phaseHistory == 0u || phaseHistory == detail::inputPhaseHistory(m_numSteps - 1u)))
+            return m_inputState;
+
+        if (auto *entry = m_shiftMemo.find(factor, phaseHistory))
+        {
+            if (entry->stable || !stable)
+                return *entry->state;
+            detail::copyShiftedSpectrum(*entry->state, io_state);
+            entry->state = &io_state;
+            entry->stable = true;
+            return io_state;
+        }
+
+        detail::shiftPitch<F, Sizes::numValuesExtent>(m_inputState, factor, sampleRate, timeDiff, io_state,
+                                                      m_sparseGainThreshold, tmp_binRange);
+        io_state.phaseHistory = detail::shiftedPhaseHistory(phaseHistory, factor, m_numSteps);
+        m_shiftMemo.add(factor, phaseHistory, io_state, stable);
+        return io_state;
+    }
+
+    detail::FormantsAlignment<F> shiftChannel(const ChannelParameters<F> &parameters, const bool isActive,
+                                              const TuningParameters<F> &tuningParameters, const F sampleRate,
+                                              const F timeDiff, const F alignmentMix,
+                                              SynthesisState<F> &io_channelState,
+                                              FormantsState<F> &io_formantsState)
     {
-        if (math::isZero(parameters.mixGain))
+        if (!isActive)
         {
             io_channelState.clear();
             io_formantsState.clear();
-            return;
+            return {};
         }
 
         const auto pitchFactor =
@@ -280,22 +892,46 @@ private:
         const auto formantsFactor = semitonesToFactor(parameters.formantsShift);
 
         io_channelState.fundamentalFrequency = pitchFactor * m_inputState.fundamentalFrequency;
-        io_formantsState.fundamentalFrequency = formantsFactor * m_inputState.fundamentalFrequency;
 
-        detail::shiftPitch(m_inputState, pitchFactor, sampleRate, timeDiff, io_channelState);
-        detail::shiftPitch<F>(m_inputState, formantsFactor, sampleRate, timeDiff, io_formantsState);
+        if (const auto &pitchShifted = shifted(pitchFactor, sampleRate, timeDiff, io_channelState, false);
+            &pitchShifted != &io_channelState)
+            detail::copyShiftedSpectrum(pitchShifted, io_channelState);
+
+        detail::FormantsAlignment<F> alignment{pitchFactor, formantsFactor, alignmentMix};
+        if (alignment.needed() && m_formantsMode == formants::Mode::Shift)
+            alignment.shiftedState = &shifted(formantsFactor, sampleRate, timeDiff, io_formantsState, true);
+        return alignment;
+    }
 
-        if (!math::equal(pitchFactor, formantsFactor))
+    void processChannel(const detail::FormantsAlignment<F> &alignment, const int stepSize,
+                        SynthesisState<F> &io_channelState)
+    {
+        if (alignment.needed())
         {
-            if (math::equal(formantsFactor, math::one<F>))
+            const auto timer = m_instrumentation.scoped(instrumentation::Stage::FormantsAlignment);
+            if (alignment.shiftedState != nullptr)
             {
-                envelopeAlignmentFactors<F>(gains<F>(m_inputState.binSpectrum), gains<F>(io_channelState.binSpectrum),
-                                            tmp_envelopeAlignmentFactors);
+                const auto [begin, end] = tmp_binRange;
+                const auto inBand = [&](const auto &values) { return values.subspan(begin, end - begin); };
+                std::fill(tmp_envelopeAlignmentFactors.begin(), tmp_envelopeAlignmentFactors.begin() + begin,
+                          math::one<F>);
+                std::fill(tmp_envelopeAlignmentFactors.begin() + end, tmp_envelopeAlignmentFactors.end(),
+                          math::one<F>);
+                envelopeAlignmentFactors<F>(gains<F>(inBand(alignment.shiftedState->binSpectrum)),
+                                            gains<F>(inBand(io_channelState.binSpectrum)),
+                                            inBand(tmp_envelopeAlignmentFactors));
             }
             else
             {
-                envelopeAlignmentFactors<F>(gains<F>(io_formantsState.binSpectrum),
-                                            gains<F>(io_channelState.binSpectrum), tmp_envelopeAlignmentFactors);
+                detail::warpedEnvelopeFactors<F>(tmp_logEnvelope, alignment.pitchFactor, alignment.formantsFactor,
+                                                 tmp_envelopeAlignmentFactors, tmp_binRange);
+            }
+            if (alignment.mix < math::one<F>)
+            {
+                std::ranges::transform(tmp_envelopeAlignmentFactors, tmp_envelopeAlignmentFactors.begin(),
+                                       [mix = alignment.mix](const auto factor) {
+                                           return math::one<F> + mix * (factor - math::one<F>);
+                                       });
             }
             std::ranges::transform(tmp_envelopeAlignmentFactors, io_channelState.coefficients,
                                    io_channelState.coefficients.begin(), std::multiplies());
@@ -303,35 +939,83 @@ private:
             std::ranges::transform(tmp_envelopeAlignmentFactors, stateGains, stateGains.begin(), std::multiplies());
         }
 
-        detail::toFilteredSpectrum(io_channelState.binSpectrum, io_channelState.spectrumSwap.inSwap());
+        const auto isSpectrumPublished = !io_channelState.spectrumBuffer.isPending();
+        if (isSpectrumPublished)
+            detail::toFilteredSpectrum<F>(io_channelState.binSpectrum, io_channelState.spectrumBuffer.inBuffer());
 
-        m_fft.transform_inverse(io_channelState.coefficients, tmp_processingSignal);
+        {
+            const auto timer = m_instrumentation.scoped(instrumentation::Stage::InverseFFT);
+            m_fft.transform_inverse(io_channelState.coefficients, tmp_processingSignal);
+        }
 
-        std::transform(tmp_processingSignal.begin(), tmp_processingSignal.end(), m_signalWindow.begin(),
-                       tmp_processingSignal.begin(),
+        const auto timer = m_instrumentation.scoped(instrumentation::Stage::OverlapAdd);
+        const auto signalEnd = tmp_processingSignal.begin() + static_cast<int>(fftLength());
+        std::transform(tmp_processingSignal.begin(), signalEnd, m_tables->window.begin(), tmp_processingSignal.begin(),
                        [factor = static_cast<F>(0.7)](const auto s, const auto w) { return factor * s * w; });
 
-        containers::ringPush(io_channelState.accumulator, math::zero<F>, stepSize);
-        std::transform(tmp_processingSignal.begin(), tmp_processingSignal.end(), io_channelState.accumulator.begin(),
+        detail::ringPush(io_channelState.accumulator, math::zero<F>, static_cast<size_t>(stepSize));
+        std::transform(tmp_processingSignal.begin(), signalEnd, io_channelState.accumulator.begin(),
                        io_channelState.accumulator.begin(), std::plus());
 
-        io_channelState.spectrumSwap.push();
+        if (isSpectrumPublished)
+            io_channelState.pushSpectrum();
     }
 
-    size_t m_fftLength{0u};
-    size_t m_overSampling{0u};
+    [[no_unique_address]] Sizes m_sizes;
     sw::dft::FFT<F> m_fft;
-
-    ChannelState<F> m_inputState;
-    std::array<ChannelState<F>, NumChannels> m_channelStates;
-    std::array<ChannelState<F>, NumChannels> m_formantsStates;
+    std::shared_ptr<const Tables<F>> m_tables;
+
+    // all state below is carved from the arena, in order of use within one processing step
+    [[no_unique_address]] detail::ArenaStorage<F, NumChannels, Sizes> m_storage;
+    Arena m_arena;
+    std::span<F> tmp_processingSignal;
+    AnalysisState<F> m_inputState;
+    std::array<VoiceState<F>, NumChannels> m_voiceStates;
+    std::span<F> tmp_envelopeAlignmentFactors;
+    std::span<std::complex<F>> tmp_cepstrum;
+    std::span<F> tmp_logEnvelope;
 
     FrequencyEnvelope<F> m_frequencyEnvelope{100u};
-
-    std::vector<F> m_signalWindow;
-
-    // helpers
-    std::vector<F> tmp_processingSignal, tmp_envelopeAlignmentFactors;
+    detail::ShiftMemo<F, 2u * NumChannels> m_shiftMemo;
+    std::uint64_t m_numSteps{0u};    ///< processed since reset, to tell phase histories of different steps apart
+
+    formants::Mode m_formantsMode{formants::Mode::Shift};
+    F m_envelopeLifterTime{static_cast<F>(0.0015)};    ///< quefrency cut off for envelope estimation, in seconds
+
+    std::array<detail::FormantsAlignment<F>, NumChannels> tmp_formantsAlignments{};
+
+    quality::Level m_qualityLevel{quality::Level::Full};
+    F m_fadeTime{static_cast<F>(0.05)};    ///< for switching formants alignment and sparse peaks, in seconds
+    std::array<F, NumChannels> m_alignmentMixes{
+      containers::makeArray<NumChannels>([](const size_t) { return math::one<F>; })};
+    F m_sparsePeaksMix{math::zero<F>};    ///< crossfade between all (0) and only strong (1) source peaks
+    F m_sparseGainThreshold{math::zero<F>};
+    Band<F> m_band;
+    detail::BinRange tmp_binRange;
+
+    PitchDetector<F> m_pitchDetector;
+    detection::Mode m_detectionMode{detection::Mode::Spectrum};
+    std::atomic<bool> m_isSpectrumRequested{true};
+    std::array<bool, NumChannels> m_isVoiceSignalRequested{};
+    F m_timeSinceDetection{math::zero<F>};
+    bool m_isDetectionSkipped{false};
+    bool m_isPhasesStale{false};    ///< analysis was skipped, so phases are not of the previous step
+
+    size_t m_lookAheadSteps{0u};
+    std::vector<F> m_lookAheadSignal;         ///< input not analysed yet, the newest step last
+    std::vector<F> m_lookAheadFrequencies;    ///< detections of the latest 2 * lookAheadSteps + 1 steps
+    std::vector<F> tmp_sortedFrequencies;
+
+    AnalysisCache<F> *m_analysisCache{nullptr};
+    std::optional<std::int64_t> m_cachePosition;
+    std::uint64_t m_windowHash{0u};    ///< of the latest input window, 0 if not hashed
+
+    [[no_unique_address]] instrumentation::Recorder<> m_instrumentation;
 };
 
+/// Processor with sizes known at compile time, with its state stored inside the instance.
+/// Meant for the common configurations, e.g. FixedProcessor<float, 2, 2048, 8>.
+template<std::floating_point F, std::uint8_t NumChannels, size_t FftLength, size_t OverSampling>
+using FixedProcessor = Processor<F, NumChannels, sizes::Fixed<FftLength, OverSampling>>;
+
 }    // namespace sw::pitchtool
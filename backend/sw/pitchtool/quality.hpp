@@ -0,0 +1,75 @@
+#pragma once
+#include "sw/pitchtool/types.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace sw::pitchtool::quality {
+
+/// Chooses the quality level from the load (processing time relative to block duration) of processed blocks.
+/// Degrades quickly if the averaged load gets high or a deadline is missed, and recovers only after the load
+/// stayed low for a while, so levels do not toggle back and forth.
+template<std::floating_point F>
+class Controller
+{
+public:
+    struct Settings
+    {
+        F averagingTime{static_cast<F>(0.1)};    ///< in seconds
+        F degradeLoad{static_cast<F>(0.7)};
+        F recoverLoad{static_cast<F>(0.35)};
+        F recoverTime{static_cast<F>(2)};    ///< in seconds below recoverLoad until one level is recovered
+        F settleTime{static_cast<F>(0.2)};    ///< in seconds after a level change without another degradation
+    };
+
+    Controller() = default;
+    explicit Controller(const Settings &settings): m_settings(settings) {}
+
+    Level update(const F load, const F blockDuration)
+    {
+        if (blockDuration <= math::zero<F>)
+            return m_level;
+
+        const auto smoothing = math::one<F> - std::exp(-blockDuration / m_settings.averagingTime);
+        m_averageLoad += smoothing * (load - m_averageLoad);
+        m_timeSinceChange += blockDuration;
+
+        const auto isOverloaded = load > math::one<F> || m_averageLoad > m_settings.degradeLoad;
+        if (isOverloaded && m_level != maxLevel && m_timeSinceChange >= m_settings.settleTime)
+            change(static_cast<Level>(static_cast<std::uint8_t>(m_level) + 1u));
+
+        m_timeBelowRecoverLoad = m_averageLoad < m_settings.recoverLoad ? m_timeBelowRecoverLoad + blockDuration :
+                                                                           math::zero<F>;
+        if (m_timeBelowRecoverLoad >= m_settings.recoverTime && m_level != Level::Full)
+            change(static_cast<Level>(static_cast<std::uint8_t>(m_level) - 1u));
+
+        return m_level;
+    }
+
+    void reset()
+    {
+        m_averageLoad = math::zero<F>;
+        change(Level::Full);
+    }
+
+    Level level() const { return m_level; }
+
+    F averageLoad() const { return m_averageLoad; }
+
+private:
+    static constexpr auto maxLevel = static_cast<Level>(numLevels - 1u);
+
+    void change(const Level level)
+    {
+        m_level = level;
+        m_timeSinceChange = math::zero<F>;
+        m_timeBelowRecoverLoad = math::zero<F>;
+    }
+
+    Settings m_settings;
+    Level m_level{Level::Full};
+    F m_averageLoad{math::zero<F>};
+    F m_timeSinceChange{math::zero<F>};
+    F m_timeBelowRecoverLoad{math::zero<F>};
+};
+
+}    // namespace sw::pitchtool::quality
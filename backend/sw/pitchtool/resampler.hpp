@@ -0,0 +1,148 @@
+#pragma once
+#include <sw/math/math.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <numbers>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace sw::pitchtool {
+
+namespace detail {
+
+/// Blackman windowed sinc low pass with factor * tapsPerPhase taps and unity DC gain, cutting off below the
+/// Nyquist frequency of the sample rate divided by factor
+template<std::floating_point F>
+std::vector<F> makeResamplingFilter(const size_t factor, const size_t tapsPerPhase)
+{
+    const auto numTaps = factor * tapsPerPhase;
+    const auto cutOff = 0.45 / static_cast<double>(factor);
+    const auto center = static_cast<double>(numTaps - 1u) / 2.0;
+    const auto windowScale = 2.0 * std::numbers::pi / static_cast<double>(numTaps - 1u);
+
+    std::vector<F> taps(numTaps);
+    for (auto i = 0u; i < numTaps; ++i)
+    {
+        const auto x = static_cast<double>(i) - center;
+        const auto sinc = std::abs(x) < 1e-9 ? 2.0 * cutOff : std::sin(2.0 * std::numbers::pi * cutOff * x) /
+                                                                 (std::numbers::pi * x);
+        const auto window = 0.42 - 0.5 * std::cos(windowScale * i) + 0.08 * std::cos(2.0 * windowScale * i);
+        taps[i] = static_cast<F>(sinc * window);
+    }
+
+    const auto sum = std::accumulate(taps.begin(), taps.end(), math::zero<F>);
+    std::ranges::transform(taps, taps.begin(), [sum](const auto tap) { return tap / sum; });
+    return taps;
+}
+
+}    // namespace detail
+
+/// Runs processing at the sample rate divided by an integer factor. Input is low pass filtered and decimated,
+/// the processed signal is interpolated back by the polyphase components of the same filter. Blocks of any size
+/// are accepted, all memory is allocated on construction.
+template<std::floating_point F>
+class Resampler
+{
+public:
+    static constexpr size_t tapsPerPhase{32u};
+    static constexpr size_t chunkSize{1024u};    ///< in samples at the high rate, larger blocks are split
+
+    explicit Resampler(const size_t factor)
+        : m_factor(factor)
+        , m_taps(detail::makeResamplingFilter<F>(factor, tapsPerPhase))
+        , m_highSignal(m_taps.size() - 1u + chunkSize, math::zero<F>)
+        , m_lowSignal(tapsPerPhase - 1u + maxLowChunkSize(), math::zero<F>)
+        , tmp_lowOutSignal(maxLowChunkSize(), math::zero<F>)
+        , m_outputFifo(chunkSize + 2u * factor, math::zero<F>)
+        , m_numOutputs(factor - 1u)
+    {
+        assert(factor > 1u);
+    }
+
+    size_t factor() const { return m_factor; }
+
+    /// added delay in samples at the high rate, half the filter length for each of both linear phase filters
+    size_t latency() const { return m_taps.size() - 1u; }
+
+    /// lowProcess(std::span<const F>, std::span<F>) is called with equally sized signals at the low rate
+    template<typename LowProcess>
+    void process(const std::span<const F> signal, const std::span<F> o_signal, LowProcess &&lowProcess)
+    {
+        assert(signal.size() == o_signal.size());
+        for (size_t offset = 0u; offset < signal.size(); offset += chunkSize)
+        {
+            const auto size = std::min(chunkSize, signal.size() - offset);
+            processChunk(signal.subspan(offset, size), o_signal.subspan(offset, size), lowProcess);
+        }
+    }
+
+private:
+    size_t maxLowChunkSize() const { return chunkSize / m_factor + 1u; }
+
+    template<typename LowProcess>
+    void processChunk(const std::span<const F> signal, const std::span<F> o_signal, LowProcess &lowProcess)
+    {
+        const auto numHistory = m_taps.size() - 1u;
+        const auto numLowHistory = tapsPerPhase - 1u;
+
+        // decimate, one output for every factor inputs
+        std::ranges::copy(signal, m_highSignal.begin() + static_cast<int>(numHistory));
+        auto numLow = 0u;
+        for (auto i = 0u; i < signal.size(); ++i)
+        {
+            if (++m_decimationPhase < m_factor)
+                continue;
+            m_decimationPhase = 0u;
+            const auto newest = m_highSignal.begin() + static_cast<int>(numHistory + i);
+            m_lowSignal[numLowHistory + numLow++] =
+              std::inner_product(m_taps.begin(), m_taps.end(), std::make_reverse_iterator(newest + 1), math::zero<F>);
+        }
+        std::shift_left(m_highSignal.begin(), m_highSignal.begin() + static_cast<int>(numHistory + signal.size()),
+                        static_cast<int>(signal.size()));
+
+        if (numLow > 0u)
+        {
+            const auto lowSignal = std::span(m_lowSignal).subspan(numLowHistory, numLow);
+            lowProcess(std::span<const F>(lowSignal), std::span(tmp_lowOutSignal).first(numLow));
+            std::ranges::copy(tmp_lowOutSignal.begin(), tmp_lowOutSignal.begin() + numLow, lowSignal.begin());
+        }
+
+        // interpolate, phase p of every output takes taps p, p + factor, ...
+        const auto gain = static_cast<F>(m_factor);
+        for (auto n = 0u; n < numLow; ++n)
+        {
+            const auto newest = m_lowSignal.begin() + static_cast<int>(numLowHistory + n);
+            for (auto phase = 0u; phase < m_factor; ++phase)
+            {
+                auto sample = math::zero<F>;
+                for (auto k = 0u; k < tapsPerPhase; ++k)
+                    sample += m_taps[phase + k * m_factor] * *(newest - static_cast<int>(k));
+                m_outputFifo[m_numOutputs++] = gain * sample;
+            }
+        }
+        std::shift_left(m_lowSignal.begin(), m_lowSignal.begin() + static_cast<int>(numLowHistory + numLow),
+                        static_cast<int>(numLow));
+
+        // the fifo starts with factor - 1 samples, so it always holds at least one chunk
+        assert(m_numOutputs >= o_signal.size());
+        std::copy(m_outputFifo.begin(), m_outputFifo.begin() + static_cast<int>(o_signal.size()), o_signal.begin());
+        std::shift_left(m_outputFifo.begin(), m_outputFifo.begin() + static_cast<int>(m_numOutputs),
+                        static_cast<int>(o_signal.size()));
+        m_numOutputs -= o_signal.size();
+    }
+
+    size_t m_factor;
+    std::vector<F> m_taps;
+    std::vector<F> m_highSignal;    ///< filter history followed by the current chunk
+    std::vector<F> m_lowSignal;     ///< filter history followed by the current decimated chunk
+    std::vector<F> tmp_lowOutSignal;
+    std::vector<F> m_outputFifo;
+    size_t m_numOutputs;
+    size_t m_decimationPhase{0u};
+};
+
+}    // namespace sw::pitchtool
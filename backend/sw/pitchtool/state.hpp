@@ -0,0 +1,112 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/// Compact binary state of parameter values, for hosts that save and restore many instances.
+/// Layout, all numbers little endian: magic, version (2 bytes), number of entries (2 bytes),
+/// then per entry the id length (1 byte), the id and the value as 32 bit float.
+namespace sw::pitchtool::state {
+
+constexpr std::array<std::byte, 4u> magic{std::byte{'S'}, std::byte{'W'}, std::byte{'P'}, std::byte{'T'}};
+constexpr std::uint16_t version{1u};
+constexpr size_t headerSize{magic.size() + 4u};
+constexpr size_t maxIdLength{255u};
+
+struct Entry
+{
+    std::string_view id;    ///< at most maxIdLength characters
+    float value{0.0f};
+};
+
+namespace detail {
+
+inline void writeLittleEndian(const std::uint32_t value, const size_t numBytes, std::byte *&io_bytes)
+{
+    for (auto i = 0u; i < numBytes; ++i)
+        *io_bytes++ = static_cast<std::byte>((value >> (8u * i)) & 0xffu);
+}
+
+inline std::uint32_t readLittleEndian(const size_t numBytes, const std::byte *&io_bytes)
+{
+    std::uint32_t value{0u};
+    for (auto i = 0u; i < numBytes; ++i)
+        value |= std::to_integer<std::uint32_t>(*io_bytes++) << (8u * i);
+    return value;
+}
+
+}    // namespace detail
+
+inline size_t encodedSize(const std::span<const Entry> entries)
+{
+    size_t size = headerSize;
+    for (const auto &entry : entries)
+        size += 1u + entry.id.size() + sizeof(float);
+    return size;
+}
+
+/// o_bytes has to be of encodedSize(entries)
+inline void encode(const std::span<const Entry> entries, const std::span<std::byte> o_bytes)
+{
+    assert(o_bytes.size() == encodedSize(entries));
+    auto *bytes = std::ranges::copy(magic, o_bytes.data()).out;
+    detail::writeLittleEndian(version, 2u, bytes);
+    detail::writeLittleEndian(static_cast<std::uint32_t>(entries.size()), 2u, bytes);
+    for (const auto &entry : entries)
+    {
+        assert(entry.id.size() <= maxIdLength);
+        detail::writeLittleEndian(static_cast<std::uint32_t>(entry.id.size()), 1u, bytes);
+        bytes = std::ranges::copy(std::as_bytes(std::span(entry.id)), bytes).out;
+        detail::writeLittleEndian(std::bit_cast<std::uint32_t>(entry.value), 4u, bytes);
+    }
+}
+
+/// whether bytes start like a binary state, other states, e.g. xml ones, are to be read otherwise
+inline bool isEncoded(const std::span<const std::byte> bytes)
+{
+    return bytes.size() >= headerSize && std::ranges::equal(bytes.first(magic.size()), magic);
+}
+
+/// Calls visitor(const Entry &) for all entries, without allocations. Visits nothing and returns false if bytes are
+/// no complete binary state of this or an older version.
+template<typename Visitor>
+bool decode(const std::span<const std::byte> bytes, Visitor &&visitor)
+{
+    if (!isEncoded(bytes))
+        return false;
+
+    const auto *position = bytes.data() + magic.size();
+    const auto *const end = bytes.data() + bytes.size();
+    if (detail::readLittleEndian(2u, position) > version)
+        return false;
+    const auto numEntries = detail::readLittleEndian(2u, position);
+
+    // validated completely before visiting, so a truncated state does not apply half
+    const auto *const entriesBegin = position;
+    for (auto i = 0u; i < numEntries; ++i)
+    {
+        if (position == end)
+            return false;
+        const auto idLength = std::to_integer<size_t>(*position);
+        if (static_cast<size_t>(end - position) < 1u + idLength + sizeof(float))
+            return false;
+        position += 1u + idLength + sizeof(float);
+    }
+
+    position = entriesBegin;
+    for (auto i = 0u; i < numEntries; ++i)
+    {
+        const auto idLength = detail::readLittleEndian(1u, position);
+        const std::string_view id(reinterpret_cast<const char *>(position), idLength);
+        position += idLength;
+        visitor(Entry{id, std::bit_cast<float>(detail::readLittleEndian(4u, position))});
+    }
+    return true;
+}
+
+}    // namespace sw::pitchtool::state
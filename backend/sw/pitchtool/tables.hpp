@@ -0,0 +1,53 @@
+#pragma once
+#include <sw/dft/transform.hpp>
+#include <sw/math/math.hpp>
+#include <sw/signals.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sw::pitchtool {
+
+/// Read only data only depending on sample type and fftLength
+template<std::floating_point F>
+struct Tables
+{
+    explicit Tables(const size_t fftLength)
+        : window(makeVonHannWindow<F>(fftLength)), fftRoundTripFactor(makeFFTRoundTripFactor(fftLength))
+    {}
+
+    const std::vector<F> window;
+    const F fftRoundTripFactor;    ///< forward and inverse transform might not be normalized
+
+private:
+    static F makeFFTRoundTripFactor(const size_t fftLength)
+    {
+        sw::dft::FFT<F> fft(fftLength);
+        std::vector<F> signal(fftLength, math::one<F>);
+        std::vector<std::complex<F>> coefficients(dft::nyquistLength(fftLength));
+        fft.transform(signal, coefficients);
+        fft.transform_inverse(coefficients, signal);
+        return signal.front();
+    }
+};
+
+/// Process wide, thread safe cache of Tables. Instances are shared as long as anybody holds them.
+template<std::floating_point F>
+std::shared_ptr<const Tables<F>> sharedTables(const size_t fftLength)
+{
+    static std::mutex mutex;
+    static std::map<size_t, std::weak_ptr<const Tables<F>>> cache;
+
+    std::lock_guard lock(mutex);
+    auto &cached = cache[fftLength];
+    if (auto tables = cached.lock())
+        return tables;
+
+    auto tables = std::make_shared<const Tables<F>>(fftLength);
+    cached = tables;
+    return tables;
+}
+
+}    // namespace sw::pitchtool
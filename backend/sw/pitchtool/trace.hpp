@@ -0,0 +1,171 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sw::pitchtool::trace {
+
+#ifdef SW_PITCHTOOL_TRACING
+constexpr bool enabled{true};
+#else
+constexpr bool enabled{false};
+#endif
+
+/// Complete event of a scope, one event for begin and end, so dropping events never leaves a scope unbalanced
+struct Event
+{
+    const char *name{nullptr};    ///< has to outlive the writer, string literals are fine
+    std::uint64_t timestamp{0u};    ///< begin in nanoseconds
+    std::uint64_t duration{0u};     ///< nanoseconds
+    std::uint32_t threadId{0u};
+};
+
+inline std::uint64_t now()
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now().time_since_epoch())
+                                        .count());
+}
+
+inline std::uint32_t currentThreadId()
+{
+    return static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+}
+
+/// Preallocated single producer single consumer queue of events. Pushing never blocks or allocates,
+/// events are dropped if the consumer is too slow.
+class Ring
+{
+public:
+    static constexpr size_t capacity{1u << 14u};
+
+    bool push(const char *name, const std::uint64_t timestamp, const std::uint64_t duration)
+    {
+        const auto writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        if (writeIndex - m_readIndex.load(std::memory_order_acquire) >= capacity)
+        {
+            m_numDropped.fetch_add(1u, std::memory_order_relaxed);
+            return false;
+        }
+        m_events[writeIndex % capacity] = {name, timestamp, duration, currentThreadId()};
+        m_writeIndex.store(writeIndex + 1u, std::memory_order_release);
+        return true;
+    }
+
+    /// calls consume for all pending events, from the consumer thread only
+    template<typename Consume>
+    void drain(Consume &&consume)
+    {
+        const auto writeIndex = m_writeIndex.load(std::memory_order_acquire);
+        auto readIndex = m_readIndex.load(std::memory_order_relaxed);
+        for (; readIndex < writeIndex; ++readIndex)
+            consume(m_events[readIndex % capacity]);
+        m_readIndex.store(readIndex, std::memory_order_release);
+    }
+
+    std::uint64_t numDropped() const { return m_numDropped.load(std::memory_order_relaxed); }
+
+private:
+    std::array<Event, capacity> m_events{};
+    std::atomic<std::uint64_t> m_writeIndex{0u};
+    std::atomic<std::uint64_t> m_readIndex{0u};
+    std::atomic<std::uint64_t> m_numDropped{0u};
+};
+
+/// Pushes one event from construction to destruction. Does nothing without ring.
+class Scope
+{
+public:
+    Scope(Ring *ring, const char *name): m_ring(ring), m_name(name), m_start(m_ring != nullptr ? now() : 0u) {}
+
+    Scope(const Scope &) = delete;
+
+    ~Scope()
+    {
+        if (m_ring != nullptr)
+            m_ring->push(m_name, m_start, now() - m_start);
+    }
+
+private:
+    Ring *m_ring{nullptr};
+    const char *m_name{nullptr};
+    std::uint64_t m_start{0u};
+};
+
+/// Background thread writing events of all added rings to a file in Chrome trace (chrome://tracing, Perfetto)
+/// format. Adding and removing rings is not meant for the audio thread.
+class Writer
+{
+public:
+    explicit Writer(const std::filesystem::path &filePath,
+                    const std::chrono::milliseconds interval = std::chrono::milliseconds(50))
+        : m_file(filePath)
+    {
+        m_file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+        m_thread = std::jthread([this, interval](std::stop_token stopToken) {
+            while (!stopToken.stop_requested())
+            {
+                std::this_thread::sleep_for(interval);
+                std::lock_guard lock(m_mutex);
+                for (auto *ring : m_rings)
+                    drain(*ring);
+            }
+        });
+    }
+
+    Writer(const Writer &) = delete;
+
+    ~Writer()
+    {
+        m_thread.request_stop();
+        m_thread.join();
+        for (auto *ring : m_rings)
+            drain(*ring);
+        m_file << "\n]}\n";
+    }
+
+    void add(Ring &ring)
+    {
+        std::lock_guard lock(m_mutex);
+        m_rings.push_back(&ring);
+    }
+
+    /// writes pending events of ring, which afterwards can be destructed
+    void remove(Ring &ring)
+    {
+        std::lock_guard lock(m_mutex);
+        drain(ring);
+        std::erase(m_rings, &ring);
+    }
+
+private:
+    void drain(Ring &ring)
+    {
+        ring.drain([this](const Event &event) {
+            m_file << (m_isFirstEvent ? "" : ",\n") << "{\"name\":\"" << event.name
+                   << "\",\"ph\":\"X\",\"ts\":" << static_cast<double>(event.timestamp) / 1000.0
+                   << ",\"dur\":" << static_cast<double>(event.duration) / 1000.0 << ",\"pid\":1,\"tid\":"
+                   << event.threadId << "}";
+            m_isFirstEvent = false;
+        });
+        m_file.flush();
+    }
+
+    std::ofstream m_file;
+    bool m_isFirstEvent{true};
+    std::mutex m_mutex;
+    std::vector<Ring *> m_rings;
+    std::jthread m_thread;
+};
+
+}    // namespace sw::pitchtool::trace
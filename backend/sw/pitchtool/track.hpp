@@ -0,0 +1,178 @@
+#pragma once
+#include "sw/pitchtool/processor.hpp"
+#include "sw/pitchtool/types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace sw::pitchtool::track {
+
+/// Fundamental frequency of one analysis window
+template<std::floating_point F>
+struct Point
+{
+    F time{math::zero<F>};          ///< center of the analysis window in seconds
+    F frequency{math::zero<F>};     ///< leq 0 if no fundamental was found
+    int midiNote{-1};               ///< closest midi note, -1 without fundamental
+    F deviation{math::zero<F>};     ///< from midiNote in semitones, in [-0.5, 0.5]
+    F confidence{math::zero<F>};    ///< share of spectral energy in harmonics of frequency, in [0, 1]
+};
+
+/// Consecutive points of the same midi note
+template<std::floating_point F>
+struct NoteEvent
+{
+    F begin{math::zero<F>};    ///< in seconds
+    F end{math::zero<F>};
+    int midiNote{-1};
+};
+
+template<std::floating_point F>
+struct Settings
+{
+    size_t fftLength{2048u};
+    size_t overSampling{8u};
+    TuningParameters<F> tuningParameters{};
+    Band<F> band{};
+    F segmentDuration{static_cast<F>(30)};    ///< in seconds, segments are processed in parallel
+    F overlapDuration{math::one<F>};          ///< processed before a segment, so detection state is continuous
+    size_t numThreads{0u};                    ///< 0 for one per core
+};
+
+namespace detail {
+
+template<std::floating_point F>
+F harmonicConfidence(const std::span<const SpectrumValue<F>> spectrum, const F fundamentalFrequency)
+{
+    if (fundamentalFrequency <= math::zero<F>)
+        return math::zero<F>;
+
+    auto energy = math::zero<F>, harmonicEnergy = math::zero<F>;
+    for (const auto &value : spectrum)
+    {
+        const auto squaredGain = value.gain * value.gain;
+        const auto harmonic = value.frequency / fundamentalFrequency;
+        energy += squaredGain;
+        if (harmonic > static_cast<F>(0.5) && std::abs(harmonic - std::round(harmonic)) < static_cast<F>(0.1))
+            harmonicEnergy += squaredGain;
+    }
+    return energy > math::zero<F> ? harmonicEnergy / energy : math::zero<F>;
+}
+
+template<std::floating_point F>
+Point<F> toPoint(const F time, const F frequency, const F confidence, const F standardPitch)
+{
+    if (frequency <= math::zero<F>)
+        return {time, frequency, -1, math::zero<F>, confidence};
+
+    const auto semitones = static_cast<F>(69) + static_cast<F>(12) * std::log2(frequency / standardPitch);
+    const auto midiNote = std::round(semitones);
+    return {time, frequency, static_cast<int>(midiNote), semitones - midiNote, confidence};
+}
+
+/// Points of the steps ending in [begin, end) of signal, processing starts overlap samples before begin
+template<std::floating_point F>
+void extractSegment(const std::span<const F> signal, const F sampleRate, const Settings<F> &settings,
+                    const size_t begin, const size_t end, const size_t overlap, std::vector<Point<F>> &o_points)
+{
+    Processor<F, 1u> processor(settings.fftLength, settings.overSampling);
+    processor.setBand(settings.band);
+    const std::array<ChannelParameters<F>, 1u> channelParameters{};
+
+    const auto stepSize = processor.stepSize();
+    const auto windowCenter = static_cast<F>(settings.fftLength) / static_cast<F>(2);
+    std::vector<F> outSignal(stepSize);
+
+    // steps are aligned to the start of the signal, so segments continue each other's step grid
+    for (auto position = (begin - std::min(begin, overlap)) / stepSize * stepSize; position < end;
+         position += stepSize)
+    {
+        if (position + stepSize > signal.size())
+            break;
+        processor.process(signal.subspan(position, stepSize), outSignal, sampleRate, settings.tuningParameters,
+                          channelParameters, math::zero<F>);
+        if (position < begin)
+            continue;
+
+        const auto time = (static_cast<F>(position + stepSize) - windowCenter) / sampleRate;
+        const auto frequency = processor.inFundamentalFrequency();
+        const auto confidence = harmonicConfidence<F>(processor.inputSpectrum(), frequency);
+        o_points.push_back(toPoint(time, frequency, confidence, settings.tuningParameters.standardPitch));
+    }
+}
+
+}    // namespace detail
+
+/// Pitch track of a whole signal, one point per step. Segments of the signal are processed in parallel, each
+/// by its own processor that starts the overlap duration early, so frequency envelope and phases are settled.
+template<std::floating_point F>
+std::vector<Point<F>> extract(const std::span<const F> signal, const F sampleRate, const Settings<F> &settings = {})
+{
+    const auto stepSize = settings.fftLength / settings.overSampling;
+    const auto segmentSize =
+      std::max<size_t>(1u, static_cast<size_t>(settings.segmentDuration * sampleRate) / stepSize) * stepSize;
+    const auto overlap = static_cast<size_t>(settings.overlapDuration * sampleRate);
+    const auto numSegments = std::max<size_t>(1u, (signal.size() + segmentSize - 1u) / segmentSize);
+    const auto numThreads = std::min(
+      numSegments,
+      std::max<size_t>(1u, settings.numThreads > 0u ? settings.numThreads : std::thread::hardware_concurrency()));
+
+    std::vector<std::vector<Point<F>>> segmentPoints(numSegments);
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(numThreads);
+        for (auto thread = 0u; thread < numThreads; ++thread)
+        {
+            threads.emplace_back([&, thread]() {
+                for (auto segment = thread; segment < numSegments; segment += numThreads)
+                {
+                    const auto begin = segment * segmentSize;
+                    detail::extractSegment(signal, sampleRate, settings, begin,
+                                           std::min(signal.size(), begin + segmentSize), overlap,
+                                           segmentPoints[segment]);
+                }
+            });
+        }
+    }
+
+    std::vector<Point<F>> points;
+    for (const auto &segment : segmentPoints)
+        points.insert(points.end(), segment.begin(), segment.end());
+    return points;
+}
+
+/// Merges consecutive points of equal midi note into notes. Points below minConfidence end a note, notes shorter
+/// than minDuration are dropped.
+template<std::floating_point F>
+std::vector<NoteEvent<F>> toNotes(const std::span<const Point<F>> points, const F minConfidence = static_cast<F>(0.5),
+                                  const F minDuration = static_cast<F>(0.05))
+{
+    std::vector<NoteEvent<F>> notes;
+    std::optional<NoteEvent<F>> current;
+    const auto finish = [&](const F time) {
+        if (current && time - current->begin >= minDuration)
+            notes.push_back({current->begin, time, current->midiNote});
+        current.reset();
+    };
+
+    for (const auto &point : points)
+    {
+        const auto midiNote = point.confidence >= minConfidence ? point.midiNote : -1;
+        if (current && current->midiNote == midiNote)
+            continue;
+        finish(point.time);
+        if (midiNote >= 0)
+            current = NoteEvent<F>{point.time, point.time, midiNote};
+    }
+    if (!points.empty())
+        finish(points.back().time);
+    return notes;
+}
+
+}    // namespace sw::pitchtool::track
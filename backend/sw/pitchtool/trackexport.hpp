@@ -0,0 +1,114 @@
+#pragma once
+#include "sw/pitchtool/track.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+namespace sw::pitchtool::track {
+
+/// One line per point, with a header line
+template<std::floating_point F>
+void writeCsv(std::ostream &stream, const std::span<const Point<F>> points)
+{
+    stream << "time,frequency,midi_note,deviation,confidence\n";
+    for (const auto &point : points)
+    {
+        stream << point.time << ',' << point.frequency << ',' << point.midiNote << ',' << point.deviation << ','
+               << point.confidence << '\n';
+    }
+}
+
+/// Object with arrays "points" and "notes"
+template<std::floating_point F>
+void writeJson(std::ostream &stream, const std::span<const Point<F>> points, const std::span<const NoteEvent<F>> notes)
+{
+    stream << "{\n  \"points\": [";
+    for (auto i = 0u; i < points.size(); ++i)
+    {
+        const auto &point = points[i];
+        stream << (i == 0u ? "\n    " : ",\n    ") << "{\"time\": " << point.time
+               << ", \"frequency\": " << point.frequency << ", \"midiNote\": " << point.midiNote
+               << ", \"deviation\": " << point.deviation << ", \"confidence\": " << point.confidence << '}';
+    }
+    stream << "\n  ],\n  \"notes\": [";
+    for (auto i = 0u; i < notes.size(); ++i)
+    {
+        const auto &note = notes[i];
+        stream << (i == 0u ? "\n    " : ",\n    ") << "{\"begin\": " << note.begin << ", \"end\": " << note.end
+               << ", \"midiNote\": " << note.midiNote << '}';
+    }
+    stream << "\n  ]\n}\n";
+}
+
+namespace detail {
+
+inline void writeBigEndian(std::ostream &stream, const std::uint32_t value, const size_t numBytes)
+{
+    for (auto i = numBytes; i > 0u; --i)
+        stream.put(static_cast<char>((value >> (8u * (i - 1u))) & 0xffu));
+}
+
+inline void appendVariableLength(std::vector<char> &o_bytes, const std::uint32_t value)
+{
+    std::array<char, 5u> groups{};
+    auto numGroups = 0u;
+    auto rest = value;
+    do
+    {
+        groups[numGroups++] = static_cast<char>(rest & 0x7fu);
+        rest >>= 7u;
+    } while (rest > 0u);
+    while (numGroups > 0u)
+    {
+        --numGroups;
+        o_bytes.push_back(static_cast<char>(groups[numGroups] | (numGroups > 0u ? 0x80 : 0x00)));
+    }
+}
+
+}    // namespace detail
+
+/// Standard midi file of format 0, one note on and off per note, at 120 beats per minute
+template<std::floating_point F>
+void writeMidi(std::ostream &stream, const std::span<const NoteEvent<F>> notes, const std::uint8_t velocity = 100u)
+{
+    constexpr std::uint32_t ticksPerQuarter{480u};
+    constexpr auto ticksPerSecond = static_cast<F>(2u * ticksPerQuarter);    // 120 bpm
+    const auto toTicks = [&](const F time) {
+        return static_cast<std::uint32_t>(std::max(math::zero<F>, std::round(time * ticksPerSecond)));
+    };
+
+    std::vector<char> track;
+    auto lastTick = std::uint32_t{0u};
+    const auto appendEvent = [&](const std::uint32_t tick, const std::uint8_t status, const std::uint8_t data0,
+                                 const std::uint8_t data1) {
+        detail::appendVariableLength(track, tick - lastTick);
+        track.insert(track.end(), {static_cast<char>(status), static_cast<char>(data0), static_cast<char>(data1)});
+        lastTick = tick;
+    };
+
+    for (const auto &note : notes)
+    {
+        const auto key = static_cast<std::uint8_t>(std::clamp(note.midiNote, 0, 127));
+        const auto begin = std::max(lastTick, toTicks(note.begin));
+        appendEvent(begin, 0x90u, key, velocity);
+        appendEvent(std::max(begin, toTicks(note.end)), 0x80u, key, 0u);
+    }
+    detail::appendVariableLength(track, 0u);
+    track.insert(track.end(), {static_cast<char>(0xff), static_cast<char>(0x2f), static_cast<char>(0x00)});
+
+    stream.write("MThd", 4);
+    detail::writeBigEndian(stream, 6u, 4u);
+    detail::writeBigEndian(stream, 0u, 2u);    // format 0
+    detail::writeBigEndian(stream, 1u, 2u);    // one track
+    detail::writeBigEndian(stream, ticksPerQuarter, 2u);
+    stream.write("MTrk", 4);
+    detail::writeBigEndian(stream, static_cast<std::uint32_t>(track.size()), 4u);
+    stream.write(track.data(), static_cast<std::streamsize>(track.size()));
+}
+
+}    // namespace sw::pitchtool::track
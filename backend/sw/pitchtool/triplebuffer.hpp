@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace sw::pitchtool {
+
+/// Hands the latest value from one writer thread to one reader thread, neither of them ever blocks and no read
+/// tears. Of three buffers the writer owns one, the reader one, and the third holds the latest published value;
+/// pushing and pulling swap indices with that third one. Each published value carries a frame number, so the reader
+/// can tell whether a value is new, and the writer can tell whether the reader took the latest one yet.
+template<typename T>
+class TripleBuffer
+{
+public:
+    explicit TripleBuffer(const T &value): m_buffers{value, value, value} {}
+
+    /// Writer side: the buffer to fill before push
+    T &inBuffer() { return m_buffers[m_writeIndex]; }
+
+    /// Writer side: publishes inBuffer, replacing a published value not pulled yet
+    void push()
+    {
+        m_frames[m_writeIndex] = ++m_numPushed;
+        const auto published = static_cast<std::uint8_t>(m_writeIndex | isNewFlag);
+        m_writeIndex = indexOf(m_published.exchange(published, std::memory_order_acq_rel));
+    }
+
+    /// Writer side: whether the latest published value was not pulled yet, so publishing again can be skipped
+    bool isPending() const { return (m_published.load(std::memory_order_acquire) & isNewFlag) != 0u; }
+
+    /// Reader side: takes the latest published value if there is a new one, valid until the next pull
+    const T &pull() const
+    {
+        if ((m_published.load(std::memory_order_relaxed) & isNewFlag) != 0u)
+            m_readIndex = indexOf(m_published.exchange(m_readIndex, std::memory_order_acq_rel));
+        return m_buffers[m_readIndex];
+    }
+
+    /// Reader side: frame number of the value of the latest pull, 0 before anything was pushed. Counts pushes, so
+    /// equal numbers mean an unchanged value.
+    std::uint64_t frame() const { return m_frames[m_readIndex]; }
+
+private:
+    static constexpr std::uint8_t indexMask{0x3u};
+    static constexpr std::uint8_t isNewFlag{0x4u};
+
+    static std::uint8_t indexOf(const std::uint8_t published)
+    {
+        return static_cast<std::uint8_t>(published & indexMask);
+    }
+
+    std::array<T, 3u> m_buffers;
+    std::array<std::uint64_t, 3u> m_frames{};
+    std::uint8_t m_writeIndex{0u};
+    mutable std::uint8_t m_readIndex{1u};
+    mutable std::atomic<std::uint8_t> m_published{2u};    ///< index of the published buffer, with isNewFlag
+    std::uint64_t m_numPushed{0u};
+};
+
+}    // namespace sw::pitchtool
@@ -1,5 +1,6 @@
 #pragma once
-#include <sw/containers/spsc/swap.hpp>
+#include "sw/pitchtool/arena.hpp"
+#include "sw/pitchtool/triplebuffer.hpp"
 #include <sw/containers/utils.hpp>
 #include <sw/dft/utils.hpp>
 #include <sw/math/math.hpp>
@@ -7,6 +8,12 @@
 #include <sw/spectrum.hpp>
 #include <sw/tuningnoteenvelope.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
 namespace sw::pitchtool {
 
 namespace tuning {
@@ -31,6 +38,46 @@ constexpr std::array<std::string_view, numTypes> typeNames{"No Tuning", "Midi",
 
 }    // namespace tuning
 
+namespace formants {
+
+enum class Mode : int
+{
+    Shift = 0,      ///< align to a pitch shifted copy of the input spectrum, one extra shift per channel
+    Envelope = 1    ///< warp the cepstral envelope of the input spectrum, estimated once for all channels
+};
+
+constexpr auto numModes = 2u;
+constexpr std::array<std::string_view, numModes> modeNames{"Shift", "Envelope"};
+
+}    // namespace formants
+
+namespace detection {
+
+enum class Mode : int
+{
+    Spectrum = 0,    ///< fundamental searched in the full analysis spectrum at every step
+    Decimated = 1    ///< separate detection on a decimated input with a smaller FFT
+};
+
+}    // namespace detection
+
+namespace quality {
+
+/// Degradation stages under CPU pressure, each one includes the ones before
+enum class Level : std::uint8_t
+{
+    Full = 0,
+    ReducedDetection = 1,      ///< fundamental frequency detected every second step only
+    SparsePeaks = 2,           ///< pitch shift skips bins far below the loudest one
+    NoFormantsAlignment = 3    ///< formants alignment faded out
+};
+
+constexpr auto numLevels = 4u;
+constexpr std::array<std::string_view, numLevels> levelNames{"Full", "Reduced Detection", "Sparse Peaks",
+                                                             "No Formants Alignment"};
+
+}    // namespace quality
+
 template<std::floating_point F>
 struct TuningParameters
 {
@@ -45,6 +92,15 @@ struct TuningParameters
     static constexpr std::array<F, 2u> attackTimeRange{static_cast<F>(0), static_cast<F>(0.2)};
 };
 
+/// Frequency range that is pitch shifted and formants aligned, the input passes unchanged outside.
+/// The fundamental frequency is searched within it as well.
+template<std::floating_point F>
+struct Band
+{
+    F lowFrequency{math::zero<F>};
+    F highFrequency{std::numeric_limits<F>::max()};
+};
+
 template<std::floating_point F>
 struct ChannelParameters
 {
@@ -80,35 +136,204 @@ constexpr F defaultDryMixGain()
     return {math::zero<F>};
 }
 
+/// Same as dft::nyquistLength, but usable for compile time sizes
+constexpr size_t nyquistLength(const size_t fftLength)
+{
+    return fftLength / 2u + 1u;
+}
+
+namespace sizes {
+
+/// fftLength and overSampling given at run time
+class Dynamic
+{
+public:
+    static constexpr auto numValuesExtent = std::dynamic_extent;
+
+    Dynamic(const size_t fftLength, const size_t overSampling): m_fftLength(fftLength), m_overSampling(overSampling)
+    {
+        assert(overSampling > 1u && overSampling * overSampling < fftLength &&
+               fftLength == (fftLength / overSampling) * overSampling);
+    }
+
+    size_t fftLength() const { return m_fftLength; }
+
+    size_t overSampling() const { return m_overSampling; }
+
+private:
+    size_t m_fftLength{0u};
+    size_t m_overSampling{0u};
+};
+
+/// Power of two fftLength closest to windowDuration, and power of two overSampling closest to
+/// windowDuration / hopDuration, at sampleRate. Durations in seconds.
+inline Dynamic fromDurations(const double sampleRate, const double windowDuration, const double hopDuration)
+{
+    const auto closestPowerOfTwo = [](const double value) {
+        return size_t{1u} << static_cast<size_t>(std::max(0.0, std::round(std::log2(value))));
+    };
+
+    const auto fftLength = std::max<size_t>(closestPowerOfTwo(windowDuration * sampleRate), 64u);
+    auto overSampling = std::max<size_t>(closestPowerOfTwo(windowDuration / hopDuration), 2u);
+    while (overSampling * overSampling >= fftLength)
+        overSampling /= 2u;
+    return Dynamic(fftLength, overSampling);
+}
+
+/// fftLength and overSampling known at compile time, so loop bounds are constants
+template<size_t FftLength, size_t OverSampling>
+struct Fixed
+{
+    static_assert(OverSampling > 1u && OverSampling * OverSampling < FftLength && FftLength % OverSampling == 0u);
+
+    static constexpr auto numValuesExtent = nyquistLength(FftLength);
+
+    static constexpr size_t fftLength() { return FftLength; }
+
+    static constexpr size_t overSampling() { return OverSampling; }
+};
+
+}    // namespace sizes
+
+/// Spectrum data needed for pitch shifting. On its own, this is all we need for formants tracking.
+/// Memory is taken from the Arena given on construction, arenaSize tells how much is needed.
 template<std::floating_point F>
-struct ChannelState
-{
-    ChannelState(const size_t fftLength)
-        : coefficients(dft::nyquistLength(fftLength), math::zero<F>)
-        , binSpectrum(dft::nyquistLength(fftLength))
-        , phases(dft::nyquistLength(fftLength))
-        , accumulator(fftLength)
-        , spectrumSwap(std::vector<SpectrumValue<F>>(dft::nyquistLength(fftLength)))
+struct SpectralState
+{
+    SpectralState(Arena &arena, const size_t fftLength)
+        : coefficients(arena.allocate<std::complex<F>>(dft::nyquistLength(fftLength), math::zero<F>))
+        , binSpectrum(arena.allocate<SpectrumValue<F>>(dft::nyquistLength(fftLength)))
+        , phases(arena.allocate<F>(dft::nyquistLength(fftLength), math::zero<F>))
     {}
 
+    static constexpr size_t arenaSize(const size_t fftLength)
+    {
+        const auto numValues = nyquistLength(fftLength);
+        return Arena::blockSize<std::complex<F>>(numValues) + Arena::blockSize<SpectrumValue<F>>(numValues) +
+               Arena::blockSize<F>(numValues);
+    }
+
     void clear()
     {
         std::ranges::fill(coefficients, math::zero<F>);
         std::ranges::fill(binSpectrum, SpectrumValue<F>{});
         std::ranges::fill(phases, math::zero<F>);
-        containers::ringPush(accumulator, math::zero<F>, accumulator.size());
-        spectrumSwap.inSwap().clear();
-        spectrumSwap.push();
+        phaseHistory = 0u;
+    }
+
+    std::span<std::complex<F>> coefficients;
+    std::span<SpectrumValue<F>> binSpectrum;
+    std::span<F> phases;
+    std::uint64_t phaseHistory{0u};    ///< states with equal values have equal phases, 0 for cleared ones
+};
+
+template<std::floating_point F>
+using FormantsState = SpectralState<F>;
+
+/// Input side: signal history, analyzed spectrum and detected fundamental
+template<std::floating_point F>
+struct AnalysisState : SpectralState<F>
+{
+    AnalysisState(Arena &arena, const size_t fftLength)
+        : SpectralState<F>(arena, fftLength)
+        , accumulator(arena.allocate<F>(fftLength, math::zero<F>))
+        , spectrumBuffer(std::vector<SpectrumValue<F>>(dft::nyquistLength(fftLength)))
+    {}
+
+    static constexpr size_t arenaSize(const size_t fftLength)
+    {
+        return SpectralState<F>::arenaSize(fftLength) + Arena::blockSize<F>(fftLength);
+    }
+
+    void clear()
+    {
+        SpectralState<F>::clear();
+        std::ranges::fill(accumulator, math::zero<F>);
+        clearSpectrum();
+        fundamentalFrequency = math::zero<F>;
+    }
+
+    /// Writer side: publishes the filtered spectrum filled in spectrumBuffer.inBuffer()
+    void pushSpectrum()
+    {
+        isSpectrumCleared = false;
+        spectrumBuffer.push();
+    }
+
+    /// Writer side: publishes an empty spectrum, unless the latest published one is, so its frame stays unchanged
+    void clearSpectrum()
+    {
+        if (std::exchange(isSpectrumCleared, true))
+            return;
+        spectrumBuffer.inBuffer().clear();
+        spectrumBuffer.push();
+    }
+
+    std::span<F> accumulator;
+    TripleBuffer<std::vector<SpectrumValue<F>>> spectrumBuffer;    ///< filtered spectrum for displays
+    bool isSpectrumCleared{false};    ///< writer side, whether the latest published spectrum is empty
+    std::atomic<F> fundamentalFrequency{math::zero<F>};    ///< leq 0 means no fundamental frequency found
+};
+
+/// Output side of one channel: tuning, shifted spectrum and overlap add accumulator
+template<std::floating_point F>
+struct SynthesisState : SpectralState<F>
+{
+    SynthesisState(Arena &arena, const size_t fftLength)
+        : SpectralState<F>(arena, fftLength)
+        , accumulator(arena.allocate<F>(fftLength, math::zero<F>))
+        , spectrumBuffer(std::vector<SpectrumValue<F>>(dft::nyquistLength(fftLength)))
+    {}
+
+    static constexpr size_t arenaSize(const size_t fftLength)
+    {
+        return SpectralState<F>::arenaSize(fftLength) + Arena::blockSize<F>(fftLength);
+    }
+
+    void clear()
+    {
+        SpectralState<F>::clear();
+        std::ranges::fill(accumulator, math::zero<F>);
+        clearSpectrum();
         fundamentalFrequency = math::zero<F>;
     }
 
+    /// Writer side: publishes the filtered spectrum filled in spectrumBuffer.inBuffer()
+    void pushSpectrum()
+    {
+        isSpectrumCleared = false;
+        spectrumBuffer.push();
+    }
+
+    /// Writer side: publishes an empty spectrum, unless the latest published one is, so its frame stays unchanged
+    void clearSpectrum()
+    {
+        if (std::exchange(isSpectrumCleared, true))
+            return;
+        spectrumBuffer.inBuffer().clear();
+        spectrumBuffer.push();
+    }
+
     TuningNoteEnvelope<F> tuningEnvelope;
-    std::vector<std::complex<F>> coefficients;
-    std::vector<SpectrumValue<F>> binSpectrum;
-    std::vector<F> phases;
-    std::vector<F> accumulator;
-    containers::spsc::Swap<std::vector<SpectrumValue<F>>> spectrumSwap;
+    std::span<F> accumulator;
+    TripleBuffer<std::vector<SpectrumValue<F>>> spectrumBuffer;    ///< filtered spectrum for displays
+    bool isSpectrumCleared{false};    ///< writer side, whether the latest published spectrum is empty
     std::atomic<F> fundamentalFrequency{math::zero<F>};    ///< leq 0 means no fundamental frequency found
 };
 
+/// Everything one output channel needs, kept together so its data is contiguous in the arena
+template<std::floating_point F>
+struct VoiceState
+{
+    VoiceState(Arena &arena, const size_t fftLength): synthesis(arena, fftLength), formants(arena, fftLength) {}
+
+    static constexpr size_t arenaSize(const size_t fftLength)
+    {
+        return SynthesisState<F>::arenaSize(fftLength) + FormantsState<F>::arenaSize(fftLength);
+    }
+
+    SynthesisState<F> synthesis;
+    FormantsState<F> formants;
+};
+
 }    // namespace sw::pitchtool
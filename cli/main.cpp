@@ -0,0 +1,114 @@
+#include "sw/cli/wavfile.h"
+#include <sw/pitchtool/track.hpp>
+#include <sw/pitchtool/trackexport.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr std::string_view usage{
+  "usage: pitchtrack <input.wav> [--csv <file>] [--json <file>] [--midi <file>] [--threads <number>]\n"
+  "                  [--standard-pitch <Hz>] [--segment <seconds>] [--min-confidence <0..1>]\n"
+  "Writes the pitch track of input.wav, as csv to standard output if no file is given.\n"};
+
+struct Options
+{
+    std::string inputFile;
+    std::optional<std::string> csvFile, jsonFile, midiFile;
+    sw::pitchtool::track::Settings<float> settings;
+    float minConfidence{0.5f};
+};
+
+Options parseOptions(const int argc, char **argv)
+{
+    Options options;
+    for (auto i = 1; i < argc; ++i)
+    {
+        const std::string_view argument(argv[i]);
+        const auto value = [&]() -> std::string {
+            if (++i >= argc)
+                throw std::invalid_argument("missing value for " + std::string(argument));
+            return argv[i];
+        };
+
+        if (argument == "--csv")
+            options.csvFile = value();
+        else if (argument == "--json")
+            options.jsonFile = value();
+        else if (argument == "--midi")
+            options.midiFile = value();
+        else if (argument == "--threads")
+            options.settings.numThreads = std::stoul(value());
+        else if (argument == "--standard-pitch")
+            options.settings.tuningParameters.standardPitch = std::stof(value());
+        else if (argument == "--segment")
+            options.settings.segmentDuration = std::stof(value());
+        else if (argument == "--min-confidence")
+            options.minConfidence = std::stof(value());
+        else if (options.inputFile.empty() && !argument.starts_with("--"))
+            options.inputFile = argument;
+        else
+            throw std::invalid_argument("unknown argument " + std::string(argument));
+    }
+    if (options.inputFile.empty())
+        throw std::invalid_argument("no input file");
+    return options;
+}
+
+std::ofstream openOutput(const std::string &filePath, const std::ios::openmode mode = std::ios::out)
+{
+    std::ofstream stream(filePath, mode);
+    if (!stream)
+        throw std::runtime_error("cannot write " + filePath);
+    return stream;
+}
+
+}    // namespace
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        const auto options = parseOptions(argc, argv);
+        const auto wavFile = sw::cli::readWavFile(options.inputFile);
+
+        const auto points = sw::pitchtool::track::extract<float>(
+          wavFile.signal, static_cast<float>(wavFile.sampleRate), options.settings);
+        const auto notes = sw::pitchtool::track::toNotes<float>(points, options.minConfidence);
+
+        if (options.csvFile)
+        {
+            auto stream = openOutput(*options.csvFile);
+            sw::pitchtool::track::writeCsv<float>(stream, points);
+        }
+        if (options.jsonFile)
+        {
+            auto stream = openOutput(*options.jsonFile);
+            sw::pitchtool::track::writeJson<float>(stream, points, notes);
+        }
+        if (options.midiFile)
+        {
+            auto stream = openOutput(*options.midiFile, std::ios::out | std::ios::binary);
+            sw::pitchtool::track::writeMidi<float>(stream, notes);
+        }
+        if (!options.csvFile && !options.jsonFile && !options.midiFile)
+            sw::pitchtool::track::writeCsv<float>(std::cout, points);
+    }
+    catch (const std::invalid_argument &error)
+    {
+        std::cerr << error.what() << '\n' << usage;
+        return EXIT_FAILURE;
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include "sw/cli/wavfile.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr std::uint16_t pcmFormat{1u};
+constexpr std::uint16_t floatFormat{3u};
+constexpr std::uint16_t extensibleFormat{0xfffeu};
+constexpr size_t framesPerBlock{4096u};    ///< the data chunk is read in blocks of this many frames
+
+std::uint32_t littleEndian(const std::uint8_t *bytes, const size_t numBytes)
+{
+    std::uint32_t value{0u};
+    for (auto i = 0u; i < numBytes; ++i)
+        value |= static_cast<std::uint32_t>(bytes[i]) << (8u * i);
+    return value;
+}
+
+double toSample(const std::uint8_t *bytes, const std::uint16_t format, const std::uint16_t bitsPerSample)
+{
+    if (format == floatFormat)
+    {
+        if (bitsPerSample == 32u)
+            return static_cast<double>(std::bit_cast<float>(littleEndian(bytes, 4u)));
+        const auto value = static_cast<std::uint64_t>(littleEndian(bytes, 4u)) |
+                           static_cast<std::uint64_t>(littleEndian(bytes + 4, 4u)) << 32u;
+        return std::bit_cast<double>(value);
+    }
+
+    if (bitsPerSample == 8u)    // unsigned
+        return (static_cast<double>(bytes[0]) - 128.0) / 128.0;
+
+    const auto numBytes = bitsPerSample / 8u;
+    const auto shift = 32u - bitsPerSample;
+    const auto value = static_cast<std::int32_t>(littleEndian(bytes, numBytes) << shift);
+    return static_cast<double>(value) / 2147483648.0;
+}
+
+}    // namespace
+
+sw::cli::WavFile sw::cli::readWavFile(const std::filesystem::path &filePath)
+{
+    std::ifstream stream(filePath, std::ios::binary);
+    if (!stream)
+        throw std::runtime_error("cannot open " + filePath.string());
+    const auto fileSize = std::filesystem::file_size(filePath);
+
+    const auto read = [&](void *o_bytes, const size_t numBytes) {
+        if (!stream.read(static_cast<char *>(o_bytes), static_cast<std::streamsize>(numBytes)))
+            throw std::runtime_error("unexpected end of " + filePath.string());
+    };
+
+    std::array<std::uint8_t, 12u> riffHeader{};
+    read(riffHeader.data(), riffHeader.size());
+    if (std::memcmp(riffHeader.data(), "RIFF", 4u) != 0 || std::memcmp(riffHeader.data() + 8, "WAVE", 4u) != 0)
+        throw std::runtime_error(filePath.string() + " is no wav file");
+
+    std::uint16_t format{0u}, numChannels{0u}, bitsPerSample{0u};
+    WavFile wavFile;
+    while (true)
+    {
+        std::array<std::uint8_t, 8u> chunkHeader{};
+        read(chunkHeader.data(), chunkHeader.size());
+        const auto chunkSize = littleEndian(chunkHeader.data() + 4, 4u);
+        const auto paddedChunkSize = static_cast<std::streamoff>(chunkSize) + chunkSize % 2u;    // even sizes
+
+        if (std::memcmp(chunkHeader.data(), "fmt ", 4u) == 0)
+        {
+            if (chunkSize < 16u)
+                throw std::runtime_error("invalid format chunk in " + filePath.string());
+            std::vector<std::uint8_t> chunk(static_cast<size_t>(paddedChunkSize));
+            read(chunk.data(), chunk.size());
+            format = static_cast<std::uint16_t>(littleEndian(chunk.data(), 2u));
+            numChannels = static_cast<std::uint16_t>(littleEndian(chunk.data() + 2, 2u));
+            wavFile.sampleRate = static_cast<double>(littleEndian(chunk.data() + 4, 4u));
+            bitsPerSample = static_cast<std::uint16_t>(littleEndian(chunk.data() + 14, 2u));
+            if (format == extensibleFormat && chunkSize >= 26u)
+                format = static_cast<std::uint16_t>(littleEndian(chunk.data() + 24, 2u));
+        }
+        else if (std::memcmp(chunkHeader.data(), "data", 4u) == 0)
+        {
+            const auto isPcm = format == pcmFormat && bitsPerSample % 8u == 0u && bitsPerSample >= 8u &&
+                               bitsPerSample <= 32u;
+            const auto isFloat = format == floatFormat && (bitsPerSample == 32u || bitsPerSample == 64u);
+            if (numChannels == 0u || !(isPcm || isFloat))
+                throw std::runtime_error("unsupported sample format in " + filePath.string());
+
+            // the last chunk may miss its pad byte, or be cut short
+            const auto numDataBytes =
+              std::min<std::uintmax_t>(chunkSize, fileSize - static_cast<std::uintmax_t>(stream.tellg()));
+            const auto frameSize = static_cast<size_t>(numChannels) * bitsPerSample / 8u;
+            const auto numFrames = static_cast<size_t>(numDataBytes / frameSize);
+            wavFile.signal.resize(numFrames);
+            std::vector<std::uint8_t> block(std::min(framesPerBlock, numFrames) * frameSize);
+            for (size_t blockBegin = 0u; blockBegin < numFrames; blockBegin += framesPerBlock)
+            {
+                const auto numBlockFrames = std::min(framesPerBlock, numFrames - blockBegin);
+                read(block.data(), numBlockFrames * frameSize);
+                for (size_t frame = 0u; frame < numBlockFrames; ++frame)
+                {
+                    auto sum = 0.0;
+                    for (auto channel = 0u; channel < numChannels; ++channel)
+                        sum += toSample(block.data() + frame * frameSize + channel * bitsPerSample / 8u, format,
+                                        bitsPerSample);
+                    wavFile.signal[blockBegin + frame] = static_cast<float>(sum / static_cast<double>(numChannels));
+                }
+            }
+            return wavFile;
+        }
+        else if (!stream.seekg(paddedChunkSize, std::ios::cur))
+        {
+            throw std::runtime_error("unexpected end of " + filePath.string());
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+namespace sw::cli {
+
+struct WavFile
+{
+    double sampleRate{0.0};
+    std::vector<float> signal;    ///< all channels mixed down to mono, in [-1, 1]
+};
+
+/// Reads uncompressed PCM of 8, 16, 24 or 32 bits and IEEE float of 32 or 64 bits, also in extensible format.
+/// The data chunk is streamed, so memory beyond the mono signal stays small. A data chunk that claims more bytes
+/// than the file has, e.g. of an interrupted recording, is read up to the end of the file.
+/// Throws std::runtime_error for files that cannot be read.
+WavFile readWavFile(const std::filesystem::path &filePath);
+
+}    // namespace sw::cli
@@ -5,6 +5,7 @@
 #include <sw/notes.hpp>
 
 #include <ranges>
+#include <utility>
 
 namespace {
 
@@ -47,6 +48,7 @@ sw::juce::pitchtool::PlotComponent::PlotComponent(sw::juce::pitchtool::Processor
 {
     addAndMakeVisible(m_signalPlot);
     addAndMakeVisible(m_signalPlotEnableLabel);
+    addAndMakeVisible(m_loadLabel);
     addAndMakeVisible(m_spectrumPlot);
     addAndMakeVisible(m_spectrumPlotEnableLabel);
     addAndMakeVisible(m_logScaleLabel);
@@ -57,6 +59,8 @@ sw::juce::pitchtool::PlotComponent::PlotComponent(sw::juce::pitchtool::Processor
     m_signalPlotEnableLabel.setEnabled(false);
     m_spectrumPlotEnableLabel.setJustificationType(::juce::Justification::centred);
     m_spectrumPlotEnableLabel.setEnabled(false);
+    m_loadLabel.setJustificationType(::juce::Justification::centredRight);
+    m_loadLabel.setInterceptsMouseClicks(false, false);
 
     setSignalPlotEnabled(true);
     setSpectrumPlotEnabled(true);
@@ -74,6 +78,8 @@ void sw::juce::pitchtool::PlotComponent::resized()
                          m_frequenciesLogScaleButton);
 
     m_signalPlotEnableLabel.setBounds(m_signalPlot.getBounds().withHeight(m_signalPlot.getHeight() / 2));
+    m_loadLabel.setBounds(
+      m_signalPlot.getBounds().toFloat().reduced(marginsSize).withHeight(2.0f * marginsSize).toNearestInt());
     m_spectrumPlotEnableLabel.setBounds(m_spectrumPlot.getBounds().withHeight(m_spectrumPlot.getHeight() / 2));
 }
 
@@ -87,6 +93,7 @@ void sw::juce::pitchtool::PlotComponent::mouseUp(const ::juce::MouseEvent &event
 
 void sw::juce::pitchtool::PlotComponent::setSignalPlotEnabled(const bool enabled)
 {
+    m_processor.setSignalHistoryRequested(enabled);
     m_signalPlot.setEnabled(enabled);
     m_signalPlotEnableLabel.setVisible(!enabled);
     if (!enabled)
@@ -99,6 +106,7 @@ void sw::juce::pitchtool::PlotComponent::setSignalPlotEnabled(const bool enabled
 
 void sw::juce::pitchtool::PlotComponent::setSpectrumPlotEnabled(const bool enabled)
 {
+    m_processor.setSpectrumRequested(enabled);
     m_spectrumPlot.setEnabled(enabled);
     m_spectrumPlotEnableLabel.setVisible(!enabled);
     m_logScaleLabel.setVisible(enabled);
@@ -109,6 +117,7 @@ void sw::juce::pitchtool::PlotComponent::setSpectrumPlotEnabled(const bool enabl
         std::vector<float> empty;
         for (auto &graph : m_spectrumPlot.graphs)
             graph.setValues(empty, empty);
+        m_plottedSpectrumFrames.fill({});
         m_spectrumPlot.repaint();
     }
 }
@@ -134,19 +143,53 @@ void sw::juce::pitchtool::PlotComponent::updatePlots()
         const auto yRange = ui::plot::spectrum::yRange(gainsLogScale);
         m_spectrumPlot.setRanges(xRange, yRange);
 
-        const auto plotSpectrum = [&](const std::vector<SpectrumValue<float>> &spectrum, ui::plot::Graph &o_graph) {
-            o_graph.setValues(ui::plot::spectrum::xValues(frequencies<float>(spectrum), frequenciesLogScale),
-                              ui::plot::spectrum::yValues(gains<float>(spectrum), gainsLogScale));
+        // spectra already plotted at the same scales and width are skipped, without any new one nothing is repainted
+        const auto numColumns = static_cast<size_t>(std::max(1, m_spectrumPlot.plotArea().toNearestInt().getWidth()));
+        const auto isResized = m_spectrumDecimator.setColumns(numColumns, frequenciesLogScale);
+        const std::pair scales{frequenciesLogScale, gainsLogScale};
+        const auto isRescaled = std::exchange(m_spectrumScales, scales) != scales || isResized;
+        auto isUpdated = false;
+        const auto plotSpectrum = [&]<std::floating_point F>(const std::vector<SpectrumValue<F>> &spectrum,
+                                                             const SpectrumFrame frame, const size_t graph) {
+            if (!isRescaled && m_plottedSpectrumFrames[graph] == frame)
+                return;
+            m_plottedSpectrumFrames[graph] = frame;
+            isUpdated = true;
+            const auto toFloat = std::views::transform([](const F value) { return static_cast<float>(value); });
+            m_spectrumDecimator.process(frequencies<F>(spectrum) | toFloat, gains<F>(spectrum) | toFloat, gainsLogScale);
+            m_spectrumPlot.graphs[graph].setValues(m_spectrumDecimator.xValues(), m_spectrumDecimator.yValues());
         };
 
-        plotSpectrum(m_processor.pitchProcessor().inputSpectrum(), m_spectrumPlot.graphs.back());
-        for (auto channel = 0u; channel < Processor::NumChannels; ++channel)
-            plotSpectrum(m_processor.pitchProcessor().outputSpectrum(channel), m_spectrumPlot.graphs[channel]);
-
-        m_spectrumPlot.repaint();
+        m_processor.visitPitchProcessor([&](const auto &pitchProcessor) {
+            const void *const identity = &pitchProcessor;    // frames count anew with each engine
+            const auto &inputSpectrum = pitchProcessor.inputSpectrum();
+            plotSpectrum(inputSpectrum, {identity, pitchProcessor.inputSpectrumFrame()}, Processor::NumChannels);
+            for (auto channel = 0u; channel < Processor::NumChannels; ++channel)
+            {
+                const auto &outputSpectrum = pitchProcessor.outputSpectrum(channel);
+                plotSpectrum(outputSpectrum, {identity, pitchProcessor.outputSpectrumFrame(channel)}, channel);
+            }
+        });
+
+        if (isUpdated)
+            m_spectrumPlot.repaint();
     }
 }
 
+void sw::juce::pitchtool::PlotComponent::setLoad(const float peakLoad, const std::uint32_t numDeadlineMisses,
+                                                  const ::sw::pitchtool::quality::Level qualityLevel)
+{
+    const auto qualityText =
+      qualityLevel == ::sw::pitchtool::quality::Level::Full ?
+        ::juce::String() :
+        ", " + ::juce::String(::sw::pitchtool::quality::levelNames[static_cast<size_t>(qualityLevel)].data());
+    m_loadLabel.setText("CPU " + ::juce::String(static_cast<int>(std::round(100.0f * peakLoad))) + "%, " +
+                          ::juce::String(numDeadlineMisses) + " misses" + qualityText,
+                        ::juce::dontSendNotification);
+    m_loadLabel.setColour(::juce::Label::textColourId,
+                          numDeadlineMisses > 0u ? ::juce::Colours::orangered : ::juce::Colours::lightgrey);
+}
+
 sw::juce::pitchtool::TuningComponent::TuningComponent(sw::juce::pitchtool::Processor &processor)
     : ui::GroupComponent("Tuning", marginsSize, true)
     , m_standardPitchAttachment(processor.parameterState(), "standardPitch", m_standardPitchSlider)
@@ -301,6 +344,8 @@ sw::juce::pitchtool::Editor::Editor(sw::juce::pitchtool::Processor &processor)
 
 sw::juce::pitchtool::Editor::~Editor()
 {
+    m_processor.setSpectrumRequested(false);
+    m_processor.setSignalHistoryRequested(false);
     m_processor.newDataBroadCaster().removeChangeListener(this);
 }
 
@@ -339,14 +384,17 @@ void sw::juce::pitchtool::Editor::changeListenerCallback(::juce::ChangeBroadcast
     {
         m_redrawStopWatch.reset();
         m_plotComponent.updatePlots();
+        m_plotComponent.setLoad(m_processor.loadMeter().pullPeakLoad(), m_processor.loadMeter().numDeadlineMisses(),
+                                m_processor.qualityLevel());
 
-        const auto &pitchProcessor = m_processor.pitchProcessor();
         const auto standardPitch = m_processor.parameterValue<float>("standardPitch");
+        m_processor.visitPitchProcessor([&](const auto &pitchProcessor) {
+            m_tuningComponent.setFrequency(static_cast<float>(pitchProcessor.inFundamentalFrequency()), standardPitch);
 
-        m_tuningComponent.setFrequency(pitchProcessor.inFundamentalFrequency(), standardPitch);
-
-        for (auto channel = 0u; channel < Processor::NumChannels; ++channel)
-            m_channelComponents[channel].setFrequency(pitchProcessor.outFundamentalFrequency(channel), standardPitch);
+            for (auto channel = 0u; channel < Processor::NumChannels; ++channel)
+                m_channelComponents[channel].setFrequency(
+                  static_cast<float>(pitchProcessor.outFundamentalFrequency(channel)), standardPitch);
+        });
     }
 }
 
@@ -15,11 +15,22 @@ public:
 
     void updatePlots();
 
+    void setLoad(float peakLoad, std::uint32_t numDeadlineMisses, ::sw::pitchtool::quality::Level qualityLevel);
+
     void resized() override;
 
     void mouseUp(const ::juce::MouseEvent &) override;
 
 private:
+    /// identifies a spectrum frame across engines, whose pitch processors count frames from the start
+    struct SpectrumFrame
+    {
+        const void *processor{nullptr};
+        std::uint64_t number{0u};
+
+        bool operator==(const SpectrumFrame &) const = default;
+    };
+
     void setSignalPlotEnabled(bool);
     void setSpectrumPlotEnabled(bool);
 
@@ -29,7 +40,11 @@ private:
     size_t m_signalPlotLength{48000u};
     ui::plot::Plot m_signalPlot;
     ::juce::Label m_signalPlotEnableLabel{"", "Click to enable Signal Plotting"};
+    ::juce::Label m_loadLabel;
     ui::plot::Plot m_spectrumPlot;
+    std::array<SpectrumFrame, Processor::NumChannels + 1u> m_plottedSpectrumFrames{};    ///< voices, then input
+    std::pair<bool, bool> m_spectrumScales{};    ///< log scales of frequencies and gains of the plotted spectra
+    ui::plot::spectrum::Decimator m_spectrumDecimator;    ///< to the width of the spectrum plot
     ::juce::Label m_spectrumPlotEnableLabel{"", "Click to enable Spectrum Plotting"};
     ::juce::Label m_logScaleLabel{"", "Log Scale: "};
     ::juce::ToggleButton m_frequenciesLogScaleButton{"Frequencies"};
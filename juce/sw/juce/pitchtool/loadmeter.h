@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace sw::juce::pitchtool {
+
+/// Processing time relative to block duration. Pushed from the audio thread, pulled lock free by the editor.
+class LoadMeter
+{
+public:
+    void push(const double processingTime, const double blockDuration)
+    {
+        if (blockDuration <= 0.0)
+            return;
+
+        const auto load = static_cast<float>(processingTime / blockDuration);
+        auto peakLoad = m_peakLoad.load(std::memory_order_relaxed);
+        while (load > peakLoad && !m_peakLoad.compare_exchange_weak(peakLoad, load, std::memory_order_relaxed))
+        {}
+
+        if (load > 1.0f)
+            m_numDeadlineMisses.fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    /// highest load since the last pull
+    float pullPeakLoad() { return m_peakLoad.exchange(0.0f, std::memory_order_relaxed); }
+
+    std::uint32_t numDeadlineMisses() const { return m_numDeadlineMisses.load(std::memory_order_relaxed); }
+
+    void resetDeadlineMisses() { m_numDeadlineMisses.store(0u, std::memory_order_relaxed); }
+
+private:
+    std::atomic<float> m_peakLoad{0.0f};
+    std::atomic<std::uint32_t> m_numDeadlineMisses{0u};
+};
+
+}    // namespace sw::juce::pitchtool
@@ -3,12 +3,33 @@
 #include <juce_core/juce_core.h>
 #include <juce_data_structures/juce_data_structures.h>
 #include <juce_events/juce_events.h>
+#include <sw/pitchtool/state.hpp>
 
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
 #include <ranges>
 #include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace {
 
+// in seconds, the defaults match an fftLength of 2048 and an overSampling of 8 at 48 kHz
+constexpr std::array<double, 3u> windowDurations{1024.0 / 48000.0, 2048.0 / 48000.0, 4096.0 / 48000.0};
+constexpr std::array<double, 3u> hopDurations{128.0 / 48000.0, 256.0 / 48000.0, 512.0 / 48000.0};
+constexpr auto defaultSampleRate = 48000.0;
+
+template<size_t N>
+::juce::StringArray toMillisecondsStrings(const std::array<double, N> &durations)
+{
+    ::juce::StringArray strings;
+    for (const auto duration : durations)
+        strings.add(::juce::String(1000.0 * duration, 1) + " ms");
+    return strings;
+}
+
 std::unique_ptr<::juce::AudioProcessorParameterGroup> createMainParameterGroup()
 {
     return std::make_unique<::juce::AudioProcessorParameterGroup>(
@@ -16,6 +37,20 @@ std::unique_ptr<::juce::AudioProcessorParameterGroup> createMainParameterGroup()
       std::make_unique<::juce::AudioParameterFloat>("dryMixGain", "Dry Mix",
                                                     ::juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f),
                                                     ::sw::pitchtool::defaultDryMixGain<float>()),
+      std::make_unique<::juce::AudioParameterBool>("envelopeFormants", "Envelope Formants", false),
+      std::make_unique<::juce::AudioParameterBool>("adaptiveQuality", "Adaptive Quality", false),
+      std::make_unique<::juce::AudioParameterChoice>("window", "Window", toMillisecondsStrings(windowDurations), 1),
+      std::make_unique<::juce::AudioParameterChoice>("hop", "Hop", toMillisecondsStrings(hopDurations), 1),
+      std::make_unique<::juce::AudioParameterBool>("resampling", "Resample to 48 kHz", false),
+      std::make_unique<::juce::AudioParameterBool>("decimatedDetection", "Decimated Pitch Detection", false),
+      std::make_unique<::juce::AudioParameterBool>("doublePrecision", "Double Precision", false),
+      std::make_unique<::juce::AudioParameterBool>("offlineQuality", "High Quality Offline Rendering", true),
+      std::make_unique<::juce::AudioParameterBool>("analysisCache", "Cache Analysis of Loops", false),
+      std::make_unique<::juce::AudioParameterBool>("bandLimited", "Band Limited", false),
+      std::make_unique<::juce::AudioParameterFloat>(
+        "bandLow", "Band Low", ::juce::NormalisableRange<float>(20.0f, 500.0f, 1.0f, 0.5f), 50.0f),
+      std::make_unique<::juce::AudioParameterFloat>(
+        "bandHigh", "Band High", ::juce::NormalisableRange<float>(2000.0f, 20000.0f, 10.0f, 0.5f), 12000.0f),
       std::make_unique<::juce::AudioParameterBool>("frequenciesLogScale", "Frequencies Log Scale", true),
       std::make_unique<::juce::AudioParameterBool>("gainsLogScale", "Gains Log Scale", true));
 }
@@ -123,31 +158,164 @@ void processMidiBuffer(
     }
 }
 
+/// One trace file for all instances of the plugin, only if tracing is compiled in and the file is given in the
+/// environment variable PITCHTOOL_TRACE_FILE.
+std::shared_ptr<::sw::pitchtool::trace::Writer> sharedTraceWriter()
+{
+    if constexpr (!::sw::pitchtool::trace::enabled)
+        return nullptr;
+
+    const auto *const filePath = std::getenv("PITCHTOOL_TRACE_FILE");
+    if (filePath == nullptr)
+        return nullptr;
+
+    static std::mutex mutex;
+    static std::weak_ptr<::sw::pitchtool::trace::Writer> weakWriter;
+
+    std::lock_guard lock(mutex);
+    auto writer = weakWriter.lock();
+    if (!writer)
+    {
+        writer = std::make_shared<::sw::pitchtool::trace::Writer>(filePath);
+        weakWriter = writer;
+    }
+    return writer;
+}
+
+/// pushes node on a list linked through nextRetired, lock free
+template<typename Node>
+void pushRetired(std::atomic<Node *> &io_list, Node *node)
+{
+    if (node == nullptr)
+        return;
+    node->nextRetired = io_list.load(std::memory_order_relaxed);
+    while (!io_list.compare_exchange_weak(node->nextRetired, node, std::memory_order_release,
+                                          std::memory_order_relaxed))
+    {}
+}
+
+template<typename Node>
+void deleteRetired(std::atomic<Node *> &io_list)
+{
+    for (auto *node = io_list.exchange(nullptr, std::memory_order_acquire); node != nullptr;)
+        delete std::exchange(node, node->nextRetired);
+}
+
 }    // namespace
 
 sw::juce::pitchtool::Processor::Processor()
     : ::juce::AudioProcessor(BusesProperties()
                                .withInput("Input", ::juce::AudioChannelSet::mono(), true)
-                               .withOutput("Output", ::juce::AudioChannelSet::mono(), true))
-    , m_processingBuffer(m_signalBufferSize, m_pitchProcessor.stepSize())
+                               .withOutput("Output", ::juce::AudioChannelSet::mono(), true)
+                               .withOutput("Voice 1", ::juce::AudioChannelSet::mono(), false)
+                               .withOutput("Voice 2", ::juce::AudioChannelSet::mono(), false)
+                               .withOutput("Dry", ::juce::AudioChannelSet::mono(), false))
+    , m_engine(new Engine(Configuration{}))
+    , tmp_crossfadeInput(4096u)
+    , tmp_crossfadeOutput(4096u)
     , m_parameterState(*this, nullptr, "state", createParameterLayout(NumChannels))
+    , m_traceWriter(sharedTraceWriter())
+{
+    static_assert(NumAuxOutputs == 3u, "one auxiliary output bus per voice and one for the dry signal");
+    for (auto &auxOutput : tmp_crossfadeAuxOutputs)
+        auxOutput.resize(tmp_crossfadeOutput.size());
+
+    setLatencySamples(static_cast<int>(m_engine.load()->latency()));
+
+    if (m_traceWriter)
+    {
+        m_traceRing = std::make_unique<::sw::pitchtool::trace::Ring>();
+        m_traceWriter->add(*m_traceRing);
+        m_engine.load()->setTraceRing(m_traceRing.get());
+    }
+
+    startTimer(50);
+}
+
+sw::juce::pitchtool::Processor::~Processor()
+{
+    stopTimer();
+    if (m_builder.joinable())
+        m_builder.join();
+
+    retire(m_pendingEngine.exchange(nullptr));
+    retire(std::exchange(m_fadingOutEngine, nullptr));
+    retire(m_engine.exchange(nullptr));
+    retire(m_pendingSignalHistories.exchange(nullptr));
+    retire(m_signalHistories.exchange(nullptr));
+    releaseRetired();
+
+    if (m_traceWriter)
+        m_traceWriter->remove(*m_traceRing);
+}
+
+void sw::juce::pitchtool::Processor::prepareToPlay(const double sampleRate, const int maximumExpectedSamplesPerBlock)
 {
-    setLatencySamples(static_cast<int>(m_pitchProcessor.overlapSize()));
+    // Hosts may call this from the audio thread while the message thread uses engines. So replaced engines are
+    // retired for the timer to release them, and background building stays with the timer.
+
+    // audio processing is stopped, so a running crossfade can be finished right away
+    retire(std::exchange(m_fadingOutEngine, nullptr));
+
+    const auto blockSize = static_cast<size_t>(std::max(maximumExpectedSamplesPerBlock, 1));
+    tmp_crossfadeInput.resize(blockSize);
+    tmp_crossfadeOutput.resize(blockSize);
+    for (auto &auxOutput : tmp_crossfadeAuxOutputs)
+        auxOutput.resize(blockSize);
+
+    m_preparedSampleRate = sampleRate;
+    m_preparedBlockSize = maximumExpectedSamplesPerBlock;
+    m_isPreparedNonRealtime = isNonRealtime();
+    const auto preparation = m_preparation.fetch_add(1u) + 1u;
+
+    // misses counted for another sample rate or block size say nothing about this one
+    m_loadMeter.resetDeadlineMisses();
+
+    // sizes depend on the sample rate, engines built or pending for another one are outdated
+    retire(m_pendingEngine.exchange(nullptr));
+    auto *engine = m_engine.load();
+    if (engine->isLatencyOutdated())
+        m_isUnalignedBlocksSeen = true;
+    if (const auto configuration = requestedConfiguration(); configuration != engine->configuration)
+    {
+        auto *newEngine = new Engine(configuration);
+        newEngine->prime(sampleRate, maximumExpectedSamplesPerBlock, m_isUnalignedBlocksSeen);
+        newEngine->setTraceRing(m_traceRing.get());
+        newEngine->preparation = preparation;
+        retire(m_engine.exchange(newEngine));
+        engine = newEngine;
+    }
+    else
+    {
+        engine->prime(sampleRate, maximumExpectedSamplesPerBlock, m_isUnalignedBlocksSeen);
+        engine->preparation = preparation;
+    }
+
+    setLatencySamples(static_cast<int>(engine->latency()));
 }
 
 bool sw::juce::pitchtool::Processor::isBusesLayoutSupported(const BusesLayout &layouts) const
 {
+    const auto isAuxOutputSupported = [&](const int bus) {
+        const auto channelSet = layouts.getChannelSet(false, bus);
+        return channelSet.isDisabled() || channelSet == ::juce::AudioChannelSet::mono();
+    };
     return layouts.getMainInputChannelSet() == ::juce::AudioChannelSet::mono() &&
-           layouts.getMainOutputChannelSet() == ::juce::AudioChannelSet::mono();
+           layouts.getMainOutputChannelSet() == ::juce::AudioChannelSet::mono() &&
+           layouts.outputBuses.size() == static_cast<int>(1u + NumAuxOutputs) &&
+           std::ranges::all_of(std::views::iota(1, layouts.outputBuses.size()), isAuxOutputSupported);
 }
 
-sw::pitchtool::TuningParameters<float> sw::juce::pitchtool::Processor::tuningParameters()
+template<std::floating_point F>
+sw::pitchtool::TuningParameters<F> sw::juce::pitchtool::Processor::tuningParameters()
 {
-    return {parameterValue<float>("standardPitch"), toSeconds(parameterValue<float>("averagingTime")),
-            toSeconds(parameterValue<float>("holdTime")), toSeconds(parameterValue<float>("attackTime"))};
+    return {parameterValue<F>("standardPitch"), static_cast<F>(toSeconds(parameterValue<float>("averagingTime"))),
+            static_cast<F>(toSeconds(parameterValue<float>("holdTime"))),
+            static_cast<F>(toSeconds(parameterValue<float>("attackTime")))};
 }
 
-sw::pitchtool::ChannelParameters<float> sw::juce::pitchtool::Processor::channelParameters(size_t zeroBasedChannel)
+template<std::floating_point F>
+sw::pitchtool::ChannelParameters<F> sw::juce::pitchtool::Processor::channelParameters(size_t zeroBasedChannel)
 {
     const auto channelAsString = std::to_string(zeroBasedChannel + 1);
 
@@ -160,40 +328,385 @@ sw::pitchtool::ChannelParameters<float> sw::juce::pitchtool::Processor::channelP
         return {};
     };
 
-    return {tuningType(), parameterValue<float>("pitchShift_" + channelAsString),
-            parameterValue<float>("formantsShift_" + channelAsString),
-            parameterValue<float>("mixGain_" + channelAsString)};
+    return {tuningType(), parameterValue<F>("pitchShift_" + channelAsString),
+            parameterValue<F>("formantsShift_" + channelAsString), parameterValue<F>("mixGain_" + channelAsString)};
 }
 
 void sw::juce::pitchtool::Processor::processBlock(::juce::AudioBuffer<float> &audioBuffer,
                                                   ::juce::MidiBuffer &midiBuffer)
 {
+    processHostBlock(audioBuffer, midiBuffer);
+}
+
+void sw::juce::pitchtool::Processor::processBlock(::juce::AudioBuffer<double> &audioBuffer,
+                                                  ::juce::MidiBuffer &midiBuffer)
+{
+    processHostBlock(audioBuffer, midiBuffer);
+}
+
+void sw::juce::pitchtool::Processor::processBlockBypassed(::juce::AudioBuffer<float> &audioBuffer,
+                                                          ::juce::MidiBuffer &)
+{
+    processHostBlockBypassed(audioBuffer);
+}
+
+void sw::juce::pitchtool::Processor::processBlockBypassed(::juce::AudioBuffer<double> &audioBuffer,
+                                                          ::juce::MidiBuffer &)
+{
+    processHostBlockBypassed(audioBuffer);
+}
+
+template<std::floating_point T>
+void sw::juce::pitchtool::Processor::processHostBlock(::juce::AudioBuffer<T> &audioBuffer,
+                                                      ::juce::MidiBuffer &midiBuffer)
+{
+    chrono::StopWatch stopWatch;
+    const ::sw::pitchtool::trace::Scope traceScope(m_traceRing.get(), "processBlock");
+
     processMidiBuffer(midiBuffer, m_currentMidiTunes);
 
-    const auto processStep = [&](auto &&inStepSignal, auto &&outStepSignal) {
-        m_pitchProcessor.process(inStepSignal, outStepSignal, static_cast<float>(getSampleRate()), tuningParameters(),
-                                 allChannelParameters(), parameterValue<float>("dryMixGain"));
-        m_newDataBroadCaster.sendChangeMessage();
-    };
+    if (!parameterValue<bool>("adaptiveQuality"))
+        m_qualityController.reset();
+    m_qualityLevel = m_qualityController.level();
+
+    swapEngines();
+    swapSignalHistories();
+
+    const auto position = timelinePosition();
+    m_engine.load(std::memory_order_relaxed)->setTimelinePosition(position);
+    if (m_fadingOutEngine != nullptr)
+        m_fadingOutEngine->setTimelinePosition(position);
 
     const auto numSamples = audioBuffer.getNumSamples();
-    m_processingBuffer.process(std::span(audioBuffer.getReadPointer(0), numSamples),
-                               std::span(audioBuffer.getWritePointer(0), numSamples), processStep);
+    const auto auxOutputs = auxSignals(audioBuffer);
+    pushSignalHistory(&SignalHistories::input, std::span(audioBuffer.getReadPointer(0), numSamples));
+    if (m_fadingOutEngine != nullptr)
+    {
+        processCrossfade(audioBuffer, auxOutputs);
+    }
+    else
+    {
+        auto &engine = *m_engine.load(std::memory_order_relaxed);
+        prepareEngine(engine);
+        processEngine(engine, std::span(audioBuffer.getReadPointer(0), numSamples),
+                      std::span(audioBuffer.getWritePointer(0), numSamples), auxOutputs);
+    }
+    pushSignalHistory(&SignalHistories::output, std::span(audioBuffer.getReadPointer(0), numSamples));
+
+    const auto blockDuration = static_cast<double>(numSamples) / getSampleRate();
+    const auto processingTime = stopWatch.elapsed();
+    m_loadMeter.push(processingTime, blockDuration);
+    if (blockDuration > 0.0)
+        m_qualityController.update(processingTime / blockDuration, blockDuration);
 }
 
-void sw::juce::pitchtool::Processor::processBlockBypassed(::juce::AudioBuffer<float> &audioBuffer,
-                                                          ::juce::MidiBuffer &)
+template<std::floating_point T>
+void sw::juce::pitchtool::Processor::processHostBlockBypassed(::juce::AudioBuffer<T> &audioBuffer)
 {
     resetMidi();
 
-    const auto processStep = [&](auto &&inStepSignal, auto &&outStepSignal) {
-        m_pitchProcessor.processByPassed(inStepSignal, outStepSignal);
-        m_newDataBroadCaster.sendChangeMessage();
-    };
+    swapEngines();
+    swapSignalHistories();
+    if (m_fadingOutEngine != nullptr)
+    {    // nothing audible to fade while bypassed
+        retire(std::exchange(m_fadingOutEngine, nullptr));
+    }
 
     const auto numSamples = audioBuffer.getNumSamples();
-    m_processingBuffer.process(std::span(audioBuffer.getReadPointer(0), numSamples),
-                               std::span(audioBuffer.getWritePointer(0), numSamples), processStep);
+    const auto auxOutputs = auxSignals(audioBuffer);
+    pushSignalHistory(&SignalHistories::input, std::span(audioBuffer.getReadPointer(0), numSamples));
+    m_engine.load(std::memory_order_relaxed)->visit([&](auto &pipeline) {
+        const auto processStep = [&](auto &&inStepSignal, auto &&outStepSignal) {
+            pipeline.pitchProcessor.processByPassed(inStepSignal, outStepSignal);
+            m_newDataBroadCaster.sendChangeMessage();
+        };
+        const auto signal = std::span(audioBuffer.getReadPointer(0), numSamples);
+        const auto o_signal = std::span(audioBuffer.getWritePointer(0), numSamples);
+        if (pipeline.voiceStaging)
+        {
+            pipeline.processVoices(signal, o_signal, auxOutputs, processStep);
+            return;
+        }
+        std::ranges::for_each(auxOutputs, [](const auto auxOutput) { std::ranges::fill(auxOutput, T{0}); });
+        pipeline.process(signal, o_signal, processStep);
+    });
+    pushSignalHistory(&SignalHistories::output, std::span(audioBuffer.getReadPointer(0), numSamples));
+}
+
+std::optional<std::int64_t> sw::juce::pitchtool::Processor::timelinePosition() const
+{
+    const auto *playHead = getPlayHead();
+    if (playHead == nullptr)
+        return std::nullopt;
+    const auto position = playHead->getPosition();
+    if (!position || !position->getIsPlaying())
+        return std::nullopt;
+    const auto timeInSamples = position->getTimeInSamples();
+    if (!timeInSamples)
+        return std::nullopt;
+    return *timeInSamples;
+}
+
+template<std::floating_point T>
+sw::juce::pitchtool::Processor::AuxSignals<T>
+sw::juce::pitchtool::Processor::auxSignals(::juce::AudioBuffer<T> &audioBuffer)
+{
+    AuxSignals<T> signals;
+    for (auto i = 0u; i < NumAuxOutputs; ++i)
+    {
+        const auto bus = static_cast<int>(i + 1u);
+        if (const auto *auxBus = getBus(false, bus); auxBus != nullptr && auxBus->isEnabled())
+        {
+            const auto channel = getChannelIndexInProcessBlockBuffer(false, bus, 0);
+            signals[i] =
+              std::span(audioBuffer.getWritePointer(channel), static_cast<size_t>(audioBuffer.getNumSamples()));
+        }
+    }
+    return signals;
+}
+
+void sw::juce::pitchtool::Processor::setSignalHistoryRequested(const bool requested)
+{
+    if (requested && !m_isSignalHistoryRequested)
+    {    // fresh ones, a display would show an outdated signal first otherwise
+        retire(m_pendingSignalHistories.exchange(new SignalHistories(m_signalBufferSize)));
+        m_isSignalHistoryRequested = true;
+    }
+    else if (!requested)
+    {    // the audio thread retires the current ones
+        m_isSignalHistoryRequested = false;
+        retire(m_pendingSignalHistories.exchange(nullptr));
+    }
+}
+
+const std::vector<float> &sw::juce::pitchtool::Processor::inputBuffer() const
+{
+    static const std::vector<float> silence(m_signalBufferSize, 0.0f);
+    const auto *histories = m_signalHistories.load();
+    return histories != nullptr ? histories->input.signal() : silence;
+}
+
+const std::vector<float> &sw::juce::pitchtool::Processor::outputBuffer() const
+{
+    static const std::vector<float> silence(m_signalBufferSize, 0.0f);
+    const auto *histories = m_signalHistories.load();
+    return histories != nullptr ? histories->output.signal() : silence;
+}
+
+template<std::floating_point T>
+void sw::juce::pitchtool::Processor::pushSignalHistory(SignalHistory SignalHistories::*history,
+                                                       const std::span<const T> signal)
+{
+    if (auto *histories = m_signalHistories.load(std::memory_order_relaxed))
+        (histories->*history).push(signal);
+}
+
+void sw::juce::pitchtool::Processor::timerCallback()
+{
+    releaseRetired();
+
+    // an engine that had to switch to the processing buffer is replaced by one that reports its latency
+    if (m_engine.load()->isLatencyOutdated())
+        m_isUnalignedBlocksSeen = true;
+
+    if (!m_isBuilding)
+    {
+        // the newest engine is the pending one, if any, both are only released on this thread
+        const Engine *newestEngine = m_pendingEngine.load();
+        if (newestEngine == nullptr)
+            newestEngine = m_engine.load();
+
+        const auto configuration = requestedConfiguration();
+        if (configuration != newestEngine->configuration || newestEngine->preparation != m_preparation ||
+            newestEngine->isLatencyOutdated())
+        {
+            m_isBuilding = true;
+            if (m_builder.joinable())
+                m_builder.join();
+            m_builder = std::jthread([this, configuration]() {
+                auto *engine = new Engine(configuration);
+                // taken before the sample rate, an engine primed for an outdated rate is never swapped in
+                engine->preparation = m_preparation.load();
+                if (const double sampleRate = m_preparedSampleRate; sampleRate > 0.0)
+                    engine->prime(sampleRate, m_preparedBlockSize, m_isUnalignedBlocksSeen);
+                engine->setTraceRing(m_traceRing.get());
+                retire(m_pendingEngine.exchange(engine));    // a pending engine not taken yet is outdated
+                m_isBuilding = false;
+            });
+        }
+    }
+
+    const auto latency = static_cast<int>(m_engine.load()->latency());
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
+
+sw::juce::pitchtool::Processor::Configuration sw::juce::pitchtool::Processor::requestedConfiguration()
+{
+    const double preparedSampleRate = m_preparedSampleRate;
+    const auto sampleRate = preparedSampleRate > 0.0 ? preparedSampleRate : defaultSampleRate;
+
+    // auxiliary outputs are staged per step at the host rate, so enabling them turns resampling off
+    const auto isVoiceOutputsUsed = std::ranges::any_of(std::views::iota(1, getBusCount(false)), [this](const int bus) {
+        return getBus(false, bus)->isEnabled();
+    });
+
+    // e.g. 96 kHz and 88.2 kHz by 2, 192 kHz by 4
+    const auto resamplingFactor = parameterValue<bool>("resampling") && !isVoiceOutputsUsed ?
+                                    static_cast<size_t>(std::max(1.0, std::round(sampleRate / 48000.0))) :
+                                    1u;
+
+    // offline rendering is not bound to real time, it doubles window and overlap and detects pitch one window ahead
+    const auto isOfflineQuality = m_isPreparedNonRealtime && parameterValue<bool>("offlineQuality");
+    const auto windowFactor = isOfflineQuality ? 2.0 : 1.0;
+
+    const auto sizes = ::sw::pitchtool::sizes::fromDurations(
+      sampleRate / static_cast<double>(resamplingFactor),
+      windowFactor * windowDurations[static_cast<size_t>(std::clamp(parameterValue<int>("window"), 0, 2))],
+      hopDurations[static_cast<size_t>(std::clamp(parameterValue<int>("hop"), 0, 2))]);
+    return {sizes.fftLength(), sizes.overSampling(), resamplingFactor, parameterValue<bool>("doublePrecision"),
+            isOfflineQuality ? sizes.overSampling() : 0u, parameterValue<bool>("analysisCache") && !isOfflineQuality,
+            isVoiceOutputsUsed};
+}
+
+void sw::juce::pitchtool::Processor::prepareEngine(Engine &engine)
+{
+    engine.visit([&]<std::floating_point F>(Pipeline<F> &pipeline) {
+        auto &pitchProcessor = pipeline.pitchProcessor;
+        pitchProcessor.setFormantsMode(parameterValue<bool>("envelopeFormants") ?
+                                         ::sw::pitchtool::formants::Mode::Envelope :
+                                         ::sw::pitchtool::formants::Mode::Shift);
+        pitchProcessor.setQualityLevel(m_qualityController.level());
+        pitchProcessor.setDetectionMode(parameterValue<bool>("decimatedDetection") ?
+                                          ::sw::pitchtool::detection::Mode::Decimated :
+                                          ::sw::pitchtool::detection::Mode::Spectrum);
+        pitchProcessor.setSpectrumRequested(m_isSpectrumRequested);
+        pitchProcessor.setBand(parameterValue<bool>("bandLimited") ?
+                                 ::sw::pitchtool::Band<F>{parameterValue<F>("bandLow"), parameterValue<F>("bandHigh")} :
+                                 ::sw::pitchtool::Band<F>{});
+    });
+}
+
+template<std::floating_point T>
+void sw::juce::pitchtool::Processor::processEngine(Engine &engine, const std::span<const T> signal,
+                                                   const std::span<T> o_signal, const AuxSignals<T> &o_auxSignals)
+{
+    engine.visit([&]<std::floating_point F>(Pipeline<F> &pipeline) {
+        const auto sampleRate = static_cast<F>(getSampleRate() / static_cast<double>(pipeline.resamplingFactor()));
+        const auto processStep = [&](auto &&inStepSignal, auto &&outStepSignal) {
+            pipeline.pitchProcessor.setCachePosition(pipeline.stepPosition());
+            pipeline.pitchProcessor.process(inStepSignal, outStepSignal, sampleRate, tuningParameters<F>(),
+                                            allChannelParameters<F>(), parameterValue<F>("dryMixGain"));
+            m_newDataBroadCaster.sendChangeMessage();
+        };
+
+        if (pipeline.voiceStaging)
+        {    // voices on enabled buses are synthesized at any mix gain
+            pipeline.pitchProcessor.setVoiceSignalsRequested(containers::makeArray<NumChannels>(
+              [&](const auto channel) { return !o_auxSignals[channel].empty(); }));
+            pipeline.processVoices(signal, o_signal, o_auxSignals, processStep);
+            return;
+        }
+        // buses enabled before prepareToPlay rebuilt the engine stay silent
+        std::ranges::for_each(o_auxSignals, [](const auto auxSignal) { std::ranges::fill(auxSignal, T{0}); });
+        pipeline.process(signal, o_signal, processStep);
+    });
+}
+
+template<std::floating_point T>
+void sw::juce::pitchtool::Processor::processCrossfade(::juce::AudioBuffer<T> &audioBuffer,
+                                                      const AuxSignals<T> &o_auxSignals)
+{
+    auto &engine = *m_engine.load(std::memory_order_relaxed);
+    prepareEngine(engine);
+    prepareEngine(*m_fadingOutEngine);
+
+    // the new engine runs silently for one window, until its synthesis is filled, and is faded in over the next one
+    const auto crossfadeGain = [this]() {
+        return std::clamp((static_cast<double>(m_crossfadePosition) - static_cast<double>(m_crossfadeLength)) /
+                            static_cast<double>(m_crossfadeLength),
+                          0.0, 1.0);
+    };
+
+    const auto numSamples = static_cast<size_t>(audioBuffer.getNumSamples());
+    for (size_t offset = 0u; offset < numSamples; offset += tmp_crossfadeInput.size())
+    {
+        const auto chunkSize = std::min(tmp_crossfadeInput.size(), numSamples - offset);
+        const auto signal = std::span(audioBuffer.getWritePointer(0) + offset, chunkSize);
+        const auto newSignal = std::span(tmp_crossfadeOutput).first(chunkSize);
+        AuxSignals<T> auxSignals;
+        AuxSignals<double> newAuxSignals;
+        for (auto i = 0u; i < NumAuxOutputs; ++i)
+        {
+            if (o_auxSignals[i].empty())
+                continue;
+            auxSignals[i] = o_auxSignals[i].subspan(offset, chunkSize);
+            newAuxSignals[i] = std::span(tmp_crossfadeAuxOutputs[i]).first(chunkSize);
+        }
+
+        std::copy(signal.begin(), signal.end(), tmp_crossfadeInput.begin());
+        processEngine(engine, std::span<const double>(tmp_crossfadeInput).first(chunkSize), newSignal, newAuxSignals);
+        processEngine(*m_fadingOutEngine, std::span<const T>(signal), signal, auxSignals);
+
+        for (size_t i = 0u; i < chunkSize; ++i, ++m_crossfadePosition)
+        {
+            const auto gain = crossfadeGain();
+            signal[i] = static_cast<T>((1.0 - gain) * signal[i] + gain * newSignal[i]);
+            for (auto j = 0u; j < NumAuxOutputs; ++j)
+            {
+                if (!auxSignals[j].empty())
+                    auxSignals[j][i] = static_cast<T>((1.0 - gain) * auxSignals[j][i] + gain * newAuxSignals[j][i]);
+            }
+        }
+    }
+
+    if (m_crossfadePosition >= 2u * m_crossfadeLength)
+        retire(std::exchange(m_fadingOutEngine, nullptr));
+}
+
+void sw::juce::pitchtool::Processor::swapEngines()
+{
+    if (m_fadingOutEngine != nullptr)
+        return;
+
+    if (auto *pendingEngine = m_pendingEngine.exchange(nullptr))
+    {
+        if (pendingEngine->preparation != m_preparation.load(std::memory_order_relaxed))
+        {    // built while prepareToPlay changed the sample rate
+            retire(pendingEngine);
+            return;
+        }
+        auto *engine = m_engine.load(std::memory_order_relaxed);
+        pendingEngine->warmUp(*engine);
+        m_fadingOutEngine = engine;
+        m_engine.store(pendingEngine);
+        m_crossfadeLength = pendingEngine->resamplingFactor() * pendingEngine->fftLength();
+        m_crossfadePosition = 0u;
+    }
+}
+
+void sw::juce::pitchtool::Processor::swapSignalHistories()
+{
+    if (auto *pendingHistories = m_pendingSignalHistories.exchange(nullptr))
+        retire(m_signalHistories.exchange(pendingHistories));
+    else if (!m_isSignalHistoryRequested.load(std::memory_order_relaxed))
+        retire(m_signalHistories.exchange(nullptr));
+}
+
+void sw::juce::pitchtool::Processor::retire(Engine *engine)
+{
+    pushRetired(m_retiredEngines, engine);
+}
+
+void sw::juce::pitchtool::Processor::retire(SignalHistories *histories)
+{
+    pushRetired(m_retiredSignalHistories, histories);
+}
+
+void sw::juce::pitchtool::Processor::releaseRetired()
+{
+    deleteRetired(m_retiredEngines);
+    deleteRetired(m_retiredSignalHistories);
 }
 
 ::juce::AudioProcessorEditor *sw::juce::pitchtool::Processor::createEditor()
@@ -203,16 +716,68 @@ void sw::juce::pitchtool::Processor::processBlockBypassed(::juce::AudioBuffer<fl
 
 void sw::juce::pitchtool::Processor::getStateInformation(::juce::MemoryBlock &destData)
 {
-    if (const auto xmlState = m_parameterState.copyState().createXml())
-        copyXmlToBinary(*xmlState, destData);
+    // binary parameter values instead of xml, hosts with many instances save and load sessions faster
+    const auto &parameters = getParameters();
+    std::vector<::sw::pitchtool::state::Entry> entries;
+    entries.reserve(static_cast<size_t>(parameters.size()));
+    for (const auto *parameter : parameters)
+    {
+        if (const auto *ranged = dynamic_cast<const ::juce::RangedAudioParameter *>(parameter))
+            entries.push_back({ranged->paramID.toRawUTF8(), ranged->convertFrom0to1(ranged->getValue())});
+    }
+
+    destData.setSize(::sw::pitchtool::state::encodedSize(entries));
+    ::sw::pitchtool::state::encode(entries,
+                                   std::span(static_cast<std::byte *>(destData.getData()), destData.getSize()));
 }
 
 void sw::juce::pitchtool::Processor::setStateInformation(const void *data, int sizeInBytes)
 {
+    const auto bytes = std::span(static_cast<const std::byte *>(data), static_cast<size_t>(std::max(sizeInBytes, 0)));
+    if (::sw::pitchtool::state::isEncoded(bytes))
+    {
+        setBinaryState(bytes);
+        return;
+    }
+
+    // states saved before the binary format
     if (const auto xmlState = getXmlFromBinary(data, sizeInBytes))
         m_parameterState.replaceState(::juce::ValueTree::fromXml(*xmlState));
 }
 
+void sw::juce::pitchtool::Processor::setBinaryState(const std::span<const std::byte> bytes)
+{
+    const auto &parameters = getParameters();
+    const auto numParameters = static_cast<size_t>(parameters.size());
+    const auto idOf = [&](const size_t index) {
+        const auto *ranged = dynamic_cast<const ::juce::RangedAudioParameter *>(parameters[static_cast<int>(index)]);
+        return ranged != nullptr ? std::string_view(ranged->paramID.toRawUTF8()) : std::string_view{};
+    };
+
+    // entries are saved in parameter order, so the next parameter is checked before searching all of them
+    std::vector<std::optional<float>> values(numParameters);
+    size_t index{0u};
+    const auto isDecoded = ::sw::pitchtool::state::decode(bytes, [&](const ::sw::pitchtool::state::Entry &entry) {
+        if (index >= numParameters || idOf(index) != entry.id)
+        {
+            const auto indices = std::views::iota(size_t{0u}, numParameters);
+            const auto found = std::ranges::find_if(indices, [&](const size_t i) { return idOf(i) == entry.id; });
+            index = found != indices.end() ? *found : numParameters;
+        }
+        if (index < numParameters)
+            values[index++] = entry.value;
+    });
+    if (!isDecoded)
+        return;
+
+    // like replacing the state tree, parameters missing in the state get their defaults
+    for (size_t i = 0u; i < numParameters; ++i)
+    {
+        if (auto *ranged = dynamic_cast<::juce::RangedAudioParameter *>(parameters[static_cast<int>(i)]))
+            ranged->setValueNotifyingHost(values[i] ? ranged->convertTo0to1(*values[i]) : ranged->getDefaultValue());
+    }
+}
+
 juce::AudioProcessor *JUCE_CALLTYPE createPluginFilter()
 {
     return new sw::juce::pitchtool::Processor();
@@ -1,8 +1,21 @@
 #pragma once
+#include "sw/juce/pitchtool/loadmeter.h"
+#include "sw/juce/pitchtool/signalhistory.h"
+#include "sw/juce/pitchtool/stepstaging.h"
+#include <atomic>
+#include <cstdint>
 #include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+#include <new>
 #include <optional>
+#include <sw/chrono/stopwatch.hpp>
 #include <sw/pitchtool/processor.hpp>
+#include <sw/pitchtool/quality.hpp>
+#include <sw/pitchtool/resampler.hpp>
+#include <sw/pitchtool/trace.hpp>
 #include <sw/processingbuffer.hpp>
+#include <thread>
+#include <type_traits>
 
 namespace sw::juce::pitchtool {
 
@@ -17,23 +30,47 @@ enum Type : int
 
 }    // namespace tuning
 
-class Processor : public ::juce::AudioProcessor
+class Processor
+    : public ::juce::AudioProcessor
+    , private ::juce::Timer
 {
 public:
     static constexpr std::uint8_t NumChannels{2u};
+    static constexpr size_t NumAuxOutputs{NumChannels + 1u};    ///< one bus per voice, then one for the dry signal
+
+    /// signals of the auxiliary output buses of one block, empty for disabled buses
+    template<std::floating_point T>
+    using AuxSignals = std::array<std::span<T>, NumAuxOutputs>;
+
+    struct Configuration
+    {
+        size_t fftLength{2048u};
+        size_t overSampling{8u};
+        size_t resamplingFactor{1u};    ///< processing runs at the sample rate divided by this
+        bool doublePrecision{false};    ///< processing precision, independent of the host's
+        size_t lookAheadSteps{0u};      ///< pitch detection ahead of synthesis, for offline rendering
+        bool analysisCache{false};      ///< reuses the analysis of steps played before, e.g. in loops
+        bool voiceOutputs{false};       ///< voices and dry signal on auxiliary buses, without resampling
+
+        bool operator==(const Configuration &) const = default;
+    };
 
     Processor();
-    ~Processor() override {}
+    ~Processor() override;
 
-    void prepareToPlay(double, int) override {}
+    void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) override;
 
     void releaseResources() override {}
 
     bool isBusesLayoutSupported(const BusesLayout &layouts) const override;
 
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
     void processBlock(::juce::AudioBuffer<float> &, ::juce::MidiBuffer &) override;
+    void processBlock(::juce::AudioBuffer<double> &, ::juce::MidiBuffer &) override;
 
     void processBlockBypassed(::juce::AudioBuffer<float> &, ::juce::MidiBuffer &) override;
+    void processBlockBypassed(::juce::AudioBuffer<double> &, ::juce::MidiBuffer &) override;
 
     ::juce::AudioProcessorEditor *createEditor() override;
     bool hasEditor() const override { return true; }
@@ -59,17 +96,36 @@ public:
     const ::juce::String getProgramName(int) override { return {}; }
     void changeProgramName(int, const ::juce::String &) override {};
 
+    /// Saves a compact binary state, see sw::pitchtool::state. Restores that as well as xml states of older versions.
     void getStateInformation(::juce::MemoryBlock &destData) override;
     void setStateInformation(const void *data, int sizeInBytes) override;
 
     ::juce::ChangeBroadcaster &newDataBroadCaster() { return m_newDataBroadCaster; }
 
+    LoadMeter &loadMeter() { return m_loadMeter; }
+
+    /// quality level of the latest processed block, readable from any thread
+    ::sw::pitchtool::quality::Level qualityLevel() const { return m_qualityLevel; }
+
+    /// whether a display needs the input spectrum, which decimated pitch detection does not compute otherwise
+    void setSpectrumRequested(const bool requested) { m_isSpectrumRequested = requested; }
+
+    /// whether a display needs the input and output histories, which are not kept otherwise
+    void setSignalHistoryRequested(bool requested);
+
     size_t signalBufferSize() const { return m_signalBufferSize; }
 
-    const std::vector<float> &inputBuffer() const { return m_processingBuffer.inputBuffer(); }
-    const std::vector<float> &outputBuffer() const { return m_processingBuffer.outputBuffer(); }
+    /// message thread only, silence until the audio thread took the requested histories
+    const std::vector<float> &inputBuffer() const;
+    const std::vector<float> &outputBuffer() const;
 
-    const ::sw::pitchtool::Processor<float, NumChannels> &pitchProcessor() const { return m_pitchProcessor; }
+    /// Calls visitor with the pitch processor of the current engine, a float or a double one. The processor stays
+    /// valid during one call on the message thread, engines are released there only.
+    template<typename Visitor>
+    void visitPitchProcessor(Visitor &&visitor) const
+    {
+        m_engine.load()->visit([&](const auto &pipeline) { visitor(pipeline.pitchProcessor); });
+    }
 
     ::juce::AudioProcessorValueTreeState &parameterState() { return m_parameterState; }
 
@@ -80,23 +136,363 @@ public:
         return static_cast<T>(parameter->convertFrom0to1(parameter->getValue()));
     }
 
-    ::sw::pitchtool::TuningParameters<float> tuningParameters();
+    template<std::floating_point F>
+    ::sw::pitchtool::TuningParameters<F> tuningParameters();
 
-    ::sw::pitchtool::ChannelParameters<float> channelParameters(size_t zeroBasedChannel);
+    template<std::floating_point F>
+    ::sw::pitchtool::ChannelParameters<F> channelParameters(size_t zeroBasedChannel);
 
-    std::array<::sw::pitchtool::ChannelParameters<float>, NumChannels> allChannelParameters()
+    template<std::floating_point F>
+    std::array<::sw::pitchtool::ChannelParameters<F>, NumChannels> allChannelParameters()
     {
-        return containers::makeArray<NumChannels>([&](const auto channel) { return channelParameters(channel); });
+        return containers::makeArray<NumChannels>([&](const auto channel) { return channelParameters<F>(channel); });
     }
 
 private:
+    /// Processing at one precision, host signals of the other one are converted in chunks
+    template<std::floating_point F>
+    struct Pipeline
+    {
+        static constexpr size_t conversionChunkSize{4096u};    ///< a multiple of all step sizes
+        static constexpr size_t analysisCacheSize{size_t{64u} << 20u};    ///< about 17 s with default sizes
+
+        explicit Pipeline(const Configuration &configuration)
+            : pitchProcessor(configuration.fftLength, configuration.overSampling)
+            , processingBuffer(2u * pitchProcessor.stepSize(), pitchProcessor.stepSize())    // partial step and output
+            , tmp_input(conversionChunkSize)
+            , tmp_output(conversionChunkSize)
+        {
+            if (configuration.resamplingFactor > 1u)
+                resampler.emplace(configuration.resamplingFactor);
+            if (configuration.voiceOutputs)
+                voiceStaging.emplace(pitchProcessor.stepSize());
+            pitchProcessor.setLookAhead(configuration.lookAheadSteps);
+            if (configuration.analysisCache)
+            {
+                try
+                {
+                    analysisCache.emplace(pitchProcessor.fftLength(), pitchProcessor.stepSize(), analysisCacheSize);
+                    pitchProcessor.setAnalysisCache(&*analysisCache);
+                }
+                catch (const std::bad_alloc &)
+                {    // without address space for it, e.g. in a 32 bit host, the engine runs without cache
+                }
+            }
+        }
+
+        Pipeline(const Pipeline &) = delete;
+        Pipeline &operator=(const Pipeline &) = delete;
+
+        /// Host timeline position of the next block in samples at the host sample rate, std::nullopt while stopped.
+        /// Steps are positioned relative to the latest known block, so equal input keeps equal step positions.
+        void setTimelinePosition(const std::optional<std::int64_t> position)
+        {
+            timelineOffset = position ? std::optional(*position / static_cast<std::int64_t>(resamplingFactor()) -
+                                                      numProcessedSamples) :
+                                        std::nullopt;
+        }
+
+        /// Position of the next step on the host timeline, in samples at the processing rate
+        std::optional<std::int64_t> stepPosition() const
+        {
+            if (!timelineOffset)
+                return std::nullopt;
+            return *timelineOffset + numProcessedSteps * static_cast<std::int64_t>(pitchProcessor.stepSize());
+        }
+
+        size_t resamplingFactor() const { return resampler ? resampler->factor() : 1u; }
+
+        /// in samples at the host sample rate, constant between primes
+        size_t latency() const
+        {
+            return resamplingFactor() *
+                     (pitchProcessor.overlapSize() + pitchProcessor.lookAheadSize() +
+                      (isProcessingBufferLatency ? pitchProcessor.stepSize() : 0u)) +
+                   (resampler ? resampler->latency() : 0u) + (voiceStaging ? voiceStaging->latency() : 0u);
+        }
+
+        /// signals at the host sample rate and precision, processStep is called at the processing rate and precision
+        template<std::floating_point T, typename ProcessStep>
+        void process(const std::span<const T> signal, const std::span<T> o_signal, ProcessStep &&processStep)
+        {
+            if constexpr (!std::is_same_v<T, F>)
+            {
+                for (size_t offset = 0u; offset < signal.size(); offset += conversionChunkSize)
+                {
+                    const auto chunkSize = std::min(conversionChunkSize, signal.size() - offset);
+                    const auto input = std::span(tmp_input).first(chunkSize);
+                    const auto output = std::span(tmp_output).first(chunkSize);
+                    std::ranges::transform(signal.subspan(offset, chunkSize), input.begin(),
+                                           [](const T sample) { return static_cast<F>(sample); });
+                    process(std::span<const F>(input), output, processStep);
+                    std::ranges::transform(output, o_signal.begin() + static_cast<int>(offset),
+                                           [](const F sample) { return static_cast<T>(sample); });
+                }
+            }
+            else if (!resampler)
+            {
+                processSteps(signal, o_signal, processStep);
+            }
+            else
+            {
+                resampler->process(signal, o_signal, [&](const auto lowSignal, const auto o_lowSignal) {
+                    processSteps(lowSignal, o_lowSignal, processStep);
+                });
+            }
+        }
+
+        /// Like process, and after each step the voices and the dry signal of the pitch processor are written to
+        /// auxSignals. Needs voice staging, which is only made without resampling.
+        template<std::floating_point T, typename ProcessStep>
+        void processVoices(const std::span<const T> signal, const std::span<T> o_signal,
+                           const AuxSignals<T> &o_auxSignals, ProcessStep &&processStep)
+        {
+            std::array<std::span<T>, NumAuxOutputs + 1u> outputs{o_signal};
+            std::ranges::copy(o_auxSignals, outputs.begin() + 1);
+
+            numProcessedSamples += static_cast<std::int64_t>(signal.size());
+            voiceStaging->process(signal, outputs, [&](const auto inStepSignal, const auto &outStepSignals) {
+                processStep(inStepSignal, outStepSignals[0]);
+                for (auto channel = 0u; channel < NumChannels; ++channel)
+                    std::ranges::copy(pitchProcessor.voiceSignal(channel), outStepSignals[1u + channel].begin());
+                std::ranges::copy(pitchProcessor.drySignal(), outStepSignals.back().begin());
+                ++numProcessedSteps;
+            });
+        }
+
+        /// Signals of whole steps are passed to processStep in place, without copies and without delay. The
+        /// processing buffer holds each processed step until the next one, so once it is used, it stays in use, or
+        /// held steps would be skipped. A signal of another size on the in place path switches for good, which adds
+        /// a step of delay the reported latency lacks, so the engine is marked outdated for that.
+        template<typename ProcessStep>
+        void processSteps(const std::span<const F> signal, const std::span<F> o_signal, ProcessStep &processStep)
+        {
+            const auto stepSize = pitchProcessor.stepSize();
+            const auto countedStep = [&](auto &&inStepSignal, auto &&outStepSignal) {
+                processStep(inStepSignal, outStepSignal);
+                ++numProcessedSteps;
+            };
+            numProcessedSamples += static_cast<std::int64_t>(signal.size());
+
+            if (!isProcessingBufferUsed && signal.size() % stepSize != 0u)
+            {
+                isProcessingBufferUsed = true;
+                isLatencyOutdated.store(true, std::memory_order_relaxed);
+            }
+            if (isProcessingBufferUsed)
+            {
+                processingBuffer.process(signal, o_signal, countedStep);
+                return;
+            }
+            for (size_t offset = 0u; offset < signal.size(); offset += stepSize)
+                countedStep(signal.subspan(offset, stepSize), o_signal.subspan(offset, stepSize));
+        }
+
+        /// Chooses the path of processSteps for blocks up to maxBlockSize: the processing buffer if they can be of
+        /// partial steps, which unalignedBlocks tells for smaller blocks, or in place. Then runs two windows of steps
+        /// and pushes one window of silence through that path, so the first real block does not pay for cold caches
+        /// and no held step of earlier blocks is output. Allocates, not meant for the audio thread.
+        void prime(const double sampleRate, const int maxBlockSize, const bool unalignedBlocks)
+        {
+            const auto hostStepSize = resamplingFactor() * pitchProcessor.stepSize();
+            isProcessingBufferUsed =
+              !voiceStaging && (unalignedBlocks || static_cast<size_t>(std::max(maxBlockSize, 1)) % hostStepSize != 0u);
+            isProcessingBufferLatency = isProcessingBufferUsed;
+            isLatencyOutdated = false;
+
+            pitchProcessor.prime(static_cast<F>(sampleRate / static_cast<double>(resamplingFactor())),
+                                 2u * pitchProcessor.overSampling());
+
+            const auto processStep = [&](auto &&inStepSignal, auto &&outStepSignal) {
+                pitchProcessor.processByPassed(inStepSignal, outStepSignal);
+            };
+            std::vector<F> silence((static_cast<size_t>(std::max(maxBlockSize, 1)) + hostStepSize - 1u) /
+                                   hostStepSize * hostStepSize);
+            for (size_t i = 0u; i < resamplingFactor() * pitchProcessor.fftLength(); i += silence.size())
+                process(std::span<const F>(silence), std::span(silence), processStep);
+        }
+
+        ::sw::pitchtool::Processor<F, NumChannels> pitchProcessor;
+        ::sw::ProcessingBuffer<F> processingBuffer;
+        std::vector<F> tmp_input;
+        std::vector<F> tmp_output;
+        std::optional<::sw::pitchtool::Resampler<F>> resampler;
+        bool isProcessingBufferUsed{false};
+        bool isProcessingBufferLatency{false};    ///< reported, as the processing buffer was chosen when primed
+        std::atomic<bool> isLatencyOutdated{false};    ///< switched to the processing buffer after priming
+        std::optional<StepStaging<F, NumAuxOutputs + 1u>> voiceStaging;    ///< mix first, then the aux outputs
+        std::optional<::sw::pitchtool::AnalysisCache<F>> analysisCache;
+        std::int64_t numProcessedSamples{0};    ///< at the processing rate, since construction
+        std::int64_t numProcessedSteps{0};
+        std::optional<std::int64_t> timelineOffset;    ///< step positions on the timeline minus processed samples
+    };
+
+    /// Everything that has to be rebuilt for another configuration, a pipeline at the configured precision
+    struct Engine
+    {
+        explicit Engine(const Configuration &_configuration): configuration(_configuration)
+        {
+            if (configuration.doublePrecision)
+                doublePipeline.emplace(configuration);
+            else
+                floatPipeline.emplace(configuration);
+        }
+
+        template<typename Visitor>
+        decltype(auto) visit(Visitor &&visitor)
+        {
+            if (doublePipeline)
+                return visitor(*doublePipeline);
+            return visitor(*floatPipeline);
+        }
+
+        template<typename Visitor>
+        decltype(auto) visit(Visitor &&visitor) const
+        {
+            if (doublePipeline)
+                return visitor(*doublePipeline);
+            return visitor(*floatPipeline);
+        }
+
+        size_t resamplingFactor() const
+        {
+            return visit([](const auto &pipeline) { return pipeline.resamplingFactor(); });
+        }
+
+        /// in samples at the host sample rate
+        size_t latency() const
+        {
+            return visit([](const auto &pipeline) { return pipeline.latency(); });
+        }
+
+        size_t fftLength() const
+        {
+            return visit([](const auto &pipeline) { return pipeline.pitchProcessor.fftLength(); });
+        }
+
+        void prime(const double sampleRate, const int maxBlockSize, const bool unalignedBlocks)
+        {
+            visit([&](auto &pipeline) { pipeline.prime(sampleRate, maxBlockSize, unalignedBlocks); });
+        }
+
+        /// whether blocks of partial steps came after priming, so the actual latency exceeds the reported one
+        bool isLatencyOutdated() const
+        {
+            return visit(
+              [](const auto &pipeline) { return pipeline.isLatencyOutdated.load(std::memory_order_relaxed); });
+        }
+
+        void setTimelinePosition(const std::optional<std::int64_t> position)
+        {
+            visit([&](auto &pipeline) { pipeline.setTimelinePosition(position); });
+        }
+
+        void setTraceRing(::sw::pitchtool::trace::Ring *traceRing)
+        {
+            visit([&](auto &pipeline) { pipeline.pitchProcessor.setTraceRing(traceRing); });
+        }
+
+        /// takes over the input history of an engine at the same precision and processing rate
+        void warmUp(const Engine &other)
+        {
+            if (static_cast<bool>(doublePipeline) != static_cast<bool>(other.doublePipeline) ||
+                resamplingFactor() != other.resamplingFactor())
+                return;
+            if (doublePipeline)
+                doublePipeline->pitchProcessor.warmUp(other.doublePipeline->pitchProcessor.inputHistory());
+            else
+                floatPipeline->pitchProcessor.warmUp(other.floatPipeline->pitchProcessor.inputHistory());
+        }
+
+        const Configuration configuration;
+        std::atomic<std::uint32_t> preparation{0u};    ///< prepareToPlay calls before it was primed for the rate
+        std::optional<Pipeline<float>> floatPipeline;
+        std::optional<Pipeline<double>> doublePipeline;
+        Engine *nextRetired{nullptr};
+    };
+
+    struct SignalHistories
+    {
+        explicit SignalHistories(const size_t size): input(size), output(size) {}
+
+        SignalHistory input;
+        SignalHistory output;
+        SignalHistories *nextRetired{nullptr};
+    };
+
+    /// Builds engines for changed configurations in the background and releases retired engines and histories.
+    void timerCallback() override;
+
+    Configuration requestedConfiguration();
+
+    void setBinaryState(std::span<const std::byte> bytes);
+
+    /// host timeline position of the current block while playing, in samples
+    std::optional<std::int64_t> timelinePosition() const;
+
+    template<std::floating_point T>
+    void processHostBlock(::juce::AudioBuffer<T> &audioBuffer, ::juce::MidiBuffer &midiBuffer);
+    template<std::floating_point T>
+    void processHostBlockBypassed(::juce::AudioBuffer<T> &audioBuffer);
+
+    void prepareEngine(Engine &engine);
+    template<std::floating_point T>
+    void processEngine(Engine &engine, std::span<const T> signal, std::span<T> o_signal,
+                       const AuxSignals<T> &o_auxSignals);
+    template<std::floating_point T>
+    void processCrossfade(::juce::AudioBuffer<T> &audioBuffer, const AuxSignals<T> &o_auxSignals);
+    template<std::floating_point T>
+    AuxSignals<T> auxSignals(::juce::AudioBuffer<T> &audioBuffer);
+    template<std::floating_point T>
+    void pushSignalHistory(SignalHistory SignalHistories::*history, std::span<const T> signal);
+
+    /// audio thread only, hands the pending engine over to be faded in
+    void swapEngines();
+    /// audio thread only, takes requested histories and retires unrequested ones
+    void swapSignalHistories();
+
+    /// Any thread, lock free. Engines and histories are released by the timer on the message thread, so the editor
+    /// can use the current ones during a call there.
+    void retire(Engine *engine);
+    void retire(SignalHistories *histories);
+    void releaseRetired();
+
     static constexpr size_t m_signalBufferSize{48000u};
     std::array<sw::pitchtool::tuning::MidiTune, NumChannels> m_currentMidiTunes;
-    ::sw::pitchtool::Processor<float, NumChannels> m_pitchProcessor{2048u, 8u};
-    ::sw::ProcessingBuffer<float> m_processingBuffer;
+
+    // engine handover: built on m_builder, which only the timer starts, or by prepareToPlay while audio is stopped,
+    // swapped in on the audio thread, released on the message thread
+    std::atomic<Engine *> m_engine{nullptr};
+    std::atomic<Engine *> m_pendingEngine{nullptr};
+    std::atomic<Engine *> m_retiredEngines{nullptr};    ///< linked through Engine::nextRetired
+    Engine *m_fadingOutEngine{nullptr};
+    size_t m_crossfadeLength{0u};
+    size_t m_crossfadePosition{0u};
+    std::vector<double> tmp_crossfadeInput;    ///< double serves hosts and engines of both precisions
+    std::vector<double> tmp_crossfadeOutput;
+    std::array<std::vector<double>, NumAuxOutputs> tmp_crossfadeAuxOutputs;
+    std::atomic<bool> m_isBuilding{false};
+    std::atomic<double> m_preparedSampleRate{0.0};    ///< 0 until prepareToPlay, engines are not primed before
+    std::atomic<int> m_preparedBlockSize{0};
+    std::atomic<bool> m_isPreparedNonRealtime{false};    ///< hosts switch render modes before prepareToPlay only
+    std::atomic<bool> m_isUnalignedBlocksSeen{false};    ///< blocks of partial steps came, so new engines buffer
+    std::atomic<std::uint32_t> m_preparation{0u};    ///< counts prepareToPlay calls, engines of older ones are outdated
+    std::jthread m_builder;
 
     ::juce::ChangeBroadcaster m_newDataBroadCaster;
+    LoadMeter m_loadMeter;
+    ::sw::pitchtool::quality::Controller<double> m_qualityController;
+    std::atomic<::sw::pitchtool::quality::Level> m_qualityLevel{::sw::pitchtool::quality::Level::Full};
+    std::atomic<bool> m_isSpectrumRequested{false};
+    std::atomic<bool> m_isSignalHistoryRequested{false};
+    // signal history handover: allocated on the message thread, taken and retired on the audio thread
+    std::atomic<SignalHistories *> m_signalHistories{nullptr};
+    std::atomic<SignalHistories *> m_pendingSignalHistories{nullptr};
+    std::atomic<SignalHistories *> m_retiredSignalHistories{nullptr};    ///< linked through nextRetired
     ::juce::AudioProcessorValueTreeState m_parameterState;
+
+    std::shared_ptr<::sw::pitchtool::trace::Writer> m_traceWriter;
+    std::unique_ptr<::sw::pitchtool::trace::Ring> m_traceRing;
 };
 
 }    // namespace sw::juce::pitchtool
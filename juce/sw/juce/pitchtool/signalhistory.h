@@ -0,0 +1,32 @@
+#pragma once
+#include <algorithm>
+#include <concepts>
+#include <span>
+#include <vector>
+
+namespace sw::juce::pitchtool {
+
+/// Latest samples of a signal for plotting, newest at the end. Pushed from the audio thread, read by the editor
+/// without synchronization, like the processing buffers before.
+class SignalHistory
+{
+public:
+    /// starts with size samples of silence
+    explicit SignalHistory(const size_t size): m_signal(size, 0.0f) {}
+
+    template<std::floating_point T>
+    void push(const std::span<const T> signal)
+    {
+        const auto numNew = std::min(signal.size(), m_signal.size());
+        std::shift_left(m_signal.begin(), m_signal.end(), static_cast<int>(numNew));
+        std::transform(signal.end() - static_cast<int>(numNew), signal.end(), m_signal.end() - static_cast<int>(numNew),
+                       [](const T sample) { return static_cast<float>(sample); });
+    }
+
+    const std::vector<float> &signal() const { return m_signal; }
+
+private:
+    std::vector<float> m_signal;
+};
+
+}    // namespace sw::juce::pitchtool
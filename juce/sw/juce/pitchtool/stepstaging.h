@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <span>
+#include <vector>
+
+namespace sw::juce::pitchtool {
+
+/// Cuts host blocks of any size into steps for processing with several outputs, which a processing buffer with a
+/// single output cannot stage. Input is collected until a step is full, outputs are handed out one step later, so
+/// all outputs stay aligned at a latency of one step. Host signals of another precision are converted on the way.
+template<std::floating_point F, size_t NumOutputs>
+class StepStaging
+{
+public:
+    explicit StepStaging(const size_t stepSize): m_input(stepSize)
+    {
+        for (auto i = 0u; i < NumOutputs; ++i)
+        {
+            m_outputs[i].assign(stepSize, F{0});
+            m_outputSpans[i] = m_outputs[i];
+        }
+    }
+
+    /// in samples
+    size_t latency() const { return m_input.size(); }
+
+    /// processStep(std::span<const F>, const std::array<std::span<F>, NumOutputs> &) is called for each full step.
+    /// Empty output signals are skipped, outputs may alias the input.
+    template<std::floating_point T, typename ProcessStep>
+    void process(const std::span<const T> signal, const std::array<std::span<T>, NumOutputs> &o_signals,
+                 ProcessStep &&processStep)
+    {
+        const auto stepSize = m_input.size();
+        for (size_t offset = 0u; offset < signal.size();)
+        {
+            const auto chunkSize = std::min(stepSize - m_position, signal.size() - offset);
+            const auto chunk = signal.subspan(offset, chunkSize);
+            std::transform(chunk.begin(), chunk.end(), m_input.begin() + static_cast<int>(m_position),
+                           [](const T sample) { return static_cast<F>(sample); });
+            for (auto i = 0u; i < NumOutputs; ++i)
+            {
+                if (o_signals[i].empty())
+                    continue;
+                const auto output = std::span<const F>(m_outputs[i]).subspan(m_position, chunkSize);
+                std::ranges::transform(output, o_signals[i].begin() + static_cast<int>(offset),
+                                       [](const F sample) { return static_cast<T>(sample); });
+            }
+
+            offset += chunkSize;
+            m_position += chunkSize;
+            if (m_position == stepSize)
+            {
+                processStep(std::span<const F>(m_input), m_outputSpans);
+                m_position = 0u;
+            }
+        }
+    }
+
+private:
+    std::vector<F> m_input;
+    std::array<std::vector<F>, NumOutputs> m_outputs;
+    std::array<std::span<F>, NumOutputs> m_outputSpans;
+    size_t m_position{0u};    ///< of the next sample within the current step
+};
+
+}    // namespace sw::juce::pitchtool
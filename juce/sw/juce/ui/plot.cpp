@@ -1,5 +1,6 @@
 #include "sw/juce/ui/plot.h"
 #include <cassert>
+#include <cmath>
 
 sw::juce::ui::plot::Graph::Graph(const ::juce::Colour &lineColor, const DrawType drawType, const float strokeThickness,
                                  const size_t initialSize)
@@ -31,8 +32,14 @@ void sw::juce::ui::plot::Graph::paint(::juce::Graphics &juceGraphics, const ::ju
             return ::juce::Point<float>(makePlotX(x), makePlotY(y));
         };
 
+        // clearing keeps the storage of the path, which is reused between frames
         m_path.clear();
-        m_path.preallocateSpace(static_cast<int>(m_drawType == DrawType::LineConnected ? m_xValues.size() : 2u * m_xValues.size()));
+        if (m_xValues.empty())
+            return m_path;
+        constexpr auto coordinatesPerPoint = 3;
+        m_path.preallocateSpace(coordinatesPerPoint * static_cast<int>(m_drawType == DrawType::LineConnected ?
+                                                                           m_xValues.size() :
+                                                                           2u * m_xValues.size()));
         if (m_drawType == DrawType::LineConnected)
         {
             m_path.startNewSubPath(makePlotPoint(m_xValues.front(), m_yValues.front()));
@@ -41,12 +48,17 @@ void sw::juce::ui::plot::Graph::paint(::juce::Graphics &juceGraphics, const ::ju
         }
         else
         {
+            // values within the same pixel column only add their highest line
             const auto lowerY = makePlotY(yRange.getStart());
-            for (auto i = 0u; i < m_xValues.size(); ++i)
+            for (auto i = 0u; i < m_xValues.size();)
             {
                 const auto plotX = makePlotX(m_xValues[i]);
+                const auto pixel = std::floor(plotX);
+                auto plotY = makePlotY(m_yValues[i]);
+                for (++i; i < m_xValues.size() && std::floor(makePlotX(m_xValues[i])) == pixel; ++i)
+                    plotY = std::min(plotY, makePlotY(m_yValues[i]));
                 m_path.startNewSubPath(plotX, lowerY);
-                m_path.lineTo(plotX, makePlotY(m_yValues[i]));
+                m_path.lineTo(plotX, plotY);
             }
         }
         return m_path;
@@ -69,6 +81,11 @@ void sw::juce::ui::plot::Plot::setRanges(const ::juce::Range<float> &xRange, con
     m_yRange = yRange;
 }
 
+::juce::Rectangle<float> sw::juce::ui::plot::Plot::plotArea() const
+{
+    return getLocalBounds().toFloat().reduced(10.0f, 10.0f);
+}
+
 void sw::juce::ui::plot::Plot::paint(::juce::Graphics &juceGraphics)
 {
     juceGraphics.fillAll(getLookAndFeel().findColour(backgroundColourId));
@@ -77,7 +94,7 @@ void sw::juce::ui::plot::Plot::paint(::juce::Graphics &juceGraphics)
     juceGraphics.setColour(getLookAndFeel().findColour(Plot::borderColourId));
     juceGraphics.drawRect(getLocalBounds().toFloat(), strokeWidth);
 
-    const auto plotArea = getLocalBounds().toFloat().reduced(10.0f, 10.0f);
+    const auto area = plotArea();
     for (auto &graph : graphs)
-        graph.paint(juceGraphics, m_xRange, m_yRange, plotArea);
+        graph.paint(juceGraphics, m_xRange, m_yRange, area);
 }
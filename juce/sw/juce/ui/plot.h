@@ -1,5 +1,7 @@
 #pragma once
 #include <array>
+#include <cassert>
+#include <cmath>
 #include <juce_graphics/juce_graphics.h>
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <limits>
@@ -153,6 +155,87 @@ inline auto yValues(R &&gains, bool logScale)
     return std::forward<R>(gains) | std::views::transform(yValue);
 }
 
+/// Reduces spectra to the smallest and largest gain per column of the plot, so the costs of plotting depend on the
+/// plot width instead of the number of bins. Columns are bounded by frequencies, so the log scales only apply to the
+/// kept values. Frequencies beyond the plot fall into the outer columns, like the plot clamps them.
+class Decimator
+{
+public:
+    /// whether the columns changed, so spectra decimated before are outdated
+    bool setColumns(const size_t numColumns, const bool frequenciesLogScale)
+    {
+        if (numColumns == m_minGains.size() && frequenciesLogScale == m_frequenciesLogScale)
+            return false;
+
+        m_frequenciesLogScale = frequenciesLogScale;
+        const auto range = xRange(frequenciesLogScale);
+        const auto xValue = [&](const float column) {
+            return range.getStart() + range.getLength() * column / static_cast<float>(numColumns);
+        };
+        m_bounds.resize(numColumns + 1u);
+        m_columnXValues.resize(numColumns);
+        for (auto i = 0u; i <= numColumns; ++i)
+        {
+            const auto x = xValue(static_cast<float>(i));
+            m_bounds[i] = frequenciesLogScale ? std::exp2(x) : x;
+        }
+        for (auto i = 0u; i < numColumns; ++i)
+            m_columnXValues[i] = xValue(static_cast<float>(i) + 0.5f);
+        m_minGains.resize(numColumns);
+        m_maxGains.resize(numColumns);
+        return true;
+    }
+
+    /// Decimates a spectrum to two values per non-empty column, its smallest and largest gain. Frequencies may be
+    /// unsorted, nearly sorted ones like bin frequencies take a few comparisons each.
+    template<ranges::TypedInputRange<float> R0, ranges::TypedInputRange<float> R1>
+    void process(R0 &&frequencies, R1 &&gains, const bool gainsLogScale)
+    {
+        assert(!m_minGains.empty());
+        std::ranges::fill(m_minGains, std::numeric_limits<float>::infinity());
+        std::ranges::fill(m_maxGains, -std::numeric_limits<float>::infinity());
+
+        const auto lastColumn = m_minGains.size() - 1u;
+        auto column = 0u;
+        auto gain = std::ranges::begin(gains);
+        for (const float frequency : frequencies)
+        {
+            while (column > 0u && frequency < m_bounds[column])
+                --column;
+            while (column < lastColumn && frequency >= m_bounds[column + 1u])
+                ++column;
+            m_minGains[column] = std::min(m_minGains[column], static_cast<float>(*gain));
+            m_maxGains[column] = std::max(m_maxGains[column], static_cast<float>(*gain));
+            ++gain;
+        }
+
+        const auto yValue = [gainsLogScale](const float g) { return gainsLogScale ? factorToDB(g) : g; };
+        m_xValues.clear();
+        m_yValues.clear();
+        for (auto i = 0u; i <= lastColumn; ++i)
+        {
+            if (m_minGains[i] > m_maxGains[i])
+                continue;
+            m_xValues.insert(m_xValues.end(), 2u, m_columnXValues[i]);
+            m_yValues.push_back(yValue(m_minGains[i]));
+            m_yValues.push_back(yValue(m_maxGains[i]));
+        }
+    }
+
+    /// of the latest process, in plot values
+    const std::vector<float> &xValues() const { return m_xValues; }
+
+    /// of the latest process, in plot values
+    const std::vector<float> &yValues() const { return m_yValues; }
+
+private:
+    bool m_frequenciesLogScale{false};
+    std::vector<float> m_bounds;           ///< frequencies between columns, from the lower to the upper plot bound
+    std::vector<float> m_columnXValues;    ///< column centers in plot values
+    std::vector<float> m_minGains, m_maxGains;
+    std::vector<float> m_xValues, m_yValues;
+};
+
 }    // namespace spectrum
 
 class Plot : public ::juce::Component
@@ -162,6 +245,9 @@ public:
 
     void setRanges(const ::juce::Range<float> &xRange, const ::juce::Range<float> &yRange);
 
+    /// bounds of the graphs, one column of values per pixel of its width is enough
+    ::juce::Rectangle<float> plotArea() const;
+
     void paint(::juce::Graphics &) override;
 
     enum ColourIds
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <sw/chrono/stopwatch.hpp>
+#include <sw/pitchtool/processor.hpp>
+#include <sw/pitchtool/state.hpp>
+#include <sw/signals.hpp>
+
+#include <iostream>
+#include <string>
+
+namespace sw::pitchtool::tests {
+
+namespace {
+
+constexpr auto benchmarkSampleRate = 48000.0f;
+constexpr auto benchmarkSignalLength = 48000u;
+
+/// average processing time per sample in nanoseconds
+template<std::floating_point F, typename P>
+double nanosecondsPerSample(P &processor, const std::vector<F> &signal,
+                            const std::array<ChannelParameters<F>, 2> &channelParameters)
+{
+    const TuningParameters<F> tuningParameters;
+    const auto stepSize = processor.stepSize();
+    std::vector<F> outSignal(stepSize);
+
+    chrono::StopWatch stopWatch;
+    for (auto i = 0u; i + stepSize <= signal.size(); i += stepSize)
+    {
+        processor.process(std::span(signal.begin() + i, stepSize), outSignal, static_cast<F>(benchmarkSampleRate),
+                          tuningParameters, channelParameters, math::zero<F>);
+    }
+    return 1e9 * stopWatch.elapsed() / static_cast<double>(signal.size());
+}
+
+template<std::floating_point F = float>
+const std::array<ChannelParameters<F>, 2> &benchmarkChannelParameters()
+{
+    static const std::array<ChannelParameters<F>, 2> parameters{
+      {{std::monostate{}, static_cast<F>(7), static_cast<F>(3), math::oneHalf<F>},
+       {std::monostate{}, static_cast<F>(-5), math::zero<F>, math::oneHalf<F>}}};
+    return parameters;
+}
+
+template<size_t FftLength, size_t OverSampling>
+void compareFixedToDynamic(const std::vector<float> &signal)
+{
+    Processor<float, 2> dynamicProcessor(FftLength, OverSampling);
+    auto fixedProcessor = std::make_unique<FixedProcessor<float, 2, FftLength, OverSampling>>();
+
+    const auto dynamicTime = nanosecondsPerSample(dynamicProcessor, signal, benchmarkChannelParameters());
+    const auto fixedTime = nanosecondsPerSample(*fixedProcessor, signal, benchmarkChannelParameters());
+
+    std::cout << "fftLength " << FftLength << ", overSampling " << OverSampling << ": dynamic " << dynamicTime
+              << " ns/sample, fixed " << fixedTime << " ns/sample" << std::endl;
+}
+
+/// processing time of one step in microseconds
+template<typename P>
+double firstStepMicroseconds(P &processor, const std::vector<float> &signal)
+{
+    std::vector<float> outSignal(processor.stepSize());
+    chrono::StopWatch stopWatch;
+    processor.process(std::span(signal.begin(), processor.stepSize()), outSignal, benchmarkSampleRate,
+                      TuningParameters<float>{}, benchmarkChannelParameters(), 0.0f);
+    return 1e6 * stopWatch.elapsed();
+}
+
+/// parameter ids of the plugin, for states of realistic size
+std::vector<std::string> stateParameterIds()
+{
+    std::vector<std::string> ids{"dryMixGain", "envelopeFormants", "adaptiveQuality", "window", "hop",
+                                 "resampling", "decimatedDetection", "doublePrecision", "offlineQuality",
+                                 "analysisCache", "bandLimited", "bandLow", "bandHigh", "frequenciesLogScale",
+                                 "gainsLogScale", "standardPitch", "averagingTime", "holdTime", "attackTime"};
+    for (const auto *channel : {"1", "2"})
+    {
+        for (const auto *name : {"tuning_", "pitchShift_", "formantsShift_", "mixGain_"})
+            ids.push_back(name + std::string(channel));
+    }
+    return ids;
+}
+
+}    // namespace
+
+TEST(ProcessorBenchmark, firstStepVsSteadyState)
+{
+    const auto signal = makeSineWave<float>(0.5f, 330.0f, benchmarkSampleRate, benchmarkSignalLength);
+
+    Processor<float, 2> coldProcessor(2048u, 8u);
+    const auto coldTime = firstStepMicroseconds(coldProcessor, signal);
+
+    Processor<float, 2> primedProcessor(2048u, 8u);
+    primedProcessor.prime(benchmarkSampleRate, 2u * primedProcessor.overSampling());
+    const auto primedTime = firstStepMicroseconds(primedProcessor, signal);
+
+    const auto steadyTime = 1e-3 * static_cast<double>(coldProcessor.stepSize()) *
+                            nanosecondsPerSample(coldProcessor, signal, benchmarkChannelParameters());
+
+    std::cout << "first step: cold " << coldTime << " us, primed " << primedTime << " us, steady state " << steadyTime
+              << " us" << std::endl;
+}
+
+TEST(ProcessorBenchmark, bandLimited)
+{
+    const auto signal = makeSineWave<float>(0.5f, 330.0f, benchmarkSampleRate, benchmarkSignalLength);
+
+    Processor<float, 2> fullProcessor(2048u, 8u);
+    Processor<float, 2> bandProcessor(2048u, 8u);
+    bandProcessor.setBand({50.0f, 12000.0f});
+
+    const auto fullTime = nanosecondsPerSample(fullProcessor, signal, benchmarkChannelParameters());
+    const auto bandTime = nanosecondsPerSample(bandProcessor, signal, benchmarkChannelParameters());
+
+    std::cout << "full band " << fullTime << " ns/sample, 50 Hz - 12 kHz " << bandTime << " ns/sample" << std::endl;
+}
+
+TEST(ProcessorBenchmark, decimatedDetection)
+{
+    const auto signal = makeSineWave<float>(0.5f, 220.0f, benchmarkSampleRate, benchmarkSignalLength);
+    const std::array<ChannelParameters<float>, 2> tunerParameters{};
+
+    Processor<float, 2> spectrumProcessor(2048u, 8u);
+    Processor<float, 2> decimatedProcessor(2048u, 8u);
+    decimatedProcessor.setDetectionMode(detection::Mode::Decimated);
+    decimatedProcessor.setSpectrumRequested(false);
+
+    const auto spectrumTime = nanosecondsPerSample(spectrumProcessor, signal, tunerParameters);
+    const auto decimatedTime = nanosecondsPerSample(decimatedProcessor, signal, tunerParameters);
+
+    std::cout << "tuner only: spectrum detection " << spectrumTime << " ns/sample, decimated detection "
+              << decimatedTime << " ns/sample" << std::endl;
+}
+
+TEST(ProcessorBenchmark, fixedVsDynamic)
+{
+    const auto signal = makeSineWave<float>(0.5f, 330.0f, benchmarkSampleRate, benchmarkSignalLength);
+    compareFixedToDynamic<1024u, 8u>(signal);
+    compareFixedToDynamic<2048u, 8u>(signal);
+    compareFixedToDynamic<4096u, 8u>(signal);
+}
+
+TEST(ProcessorBenchmark, floatVsDouble)
+{
+    Processor<float, 2> floatProcessor(2048u, 8u);
+    Processor<double, 2> doubleProcessor(2048u, 8u);
+
+    const auto floatSignal = makeSineWave<float>(0.5f, 330.0f, benchmarkSampleRate, benchmarkSignalLength);
+    const auto doubleSignal = makeSineWave<double>(0.5, 330.0, benchmarkSampleRate, benchmarkSignalLength);
+
+    const auto floatTime = nanosecondsPerSample(floatProcessor, floatSignal, benchmarkChannelParameters<float>());
+    const auto doubleTime = nanosecondsPerSample(doubleProcessor, doubleSignal, benchmarkChannelParameters<double>());
+
+    std::cout << "float " << floatTime << " ns/sample, double " << doubleTime << " ns/sample" << std::endl;
+}
+
+TEST(ProcessorBenchmark, analysisCacheColdVsWarm)
+{
+    const auto signal = makeSineWave<float>(0.5f, 330.0f, benchmarkSampleRate, benchmarkSignalLength);
+
+    Processor<float, 2> processor(2048u, 8u);
+    AnalysisCache<float> cache(processor.fftLength(), processor.stepSize(), size_t{1u} << 28u);
+    processor.setAnalysisCache(&cache);
+
+    // one pass of a loop, positions start over with each pass
+    const auto loopPass = [&]() {
+        const TuningParameters<float> tuningParameters;
+        const auto stepSize = processor.stepSize();
+        std::vector<float> outSignal(stepSize);
+
+        chrono::StopWatch stopWatch;
+        for (auto i = 0u; i + stepSize <= signal.size(); i += stepSize)
+        {
+            processor.setCachePosition(static_cast<std::int64_t>(i));
+            processor.process(std::span(signal.begin() + i, stepSize), outSignal, benchmarkSampleRate,
+                              tuningParameters, benchmarkChannelParameters(), 0.0f);
+        }
+        return 1e9 * stopWatch.elapsed() / static_cast<double>(signal.size());
+    };
+
+    const auto coldTime = loopPass();
+    const auto warmTime = loopPass();
+
+    std::cout << "analysis cache cold " << coldTime << " ns/sample, warm " << warmTime << " ns/sample, "
+              << cache.numHits() << " hits" << std::endl;
+}
+
+TEST(StateBenchmark, encodeDecodeManyStates)
+{
+    // the binary format only, without the plugin's parameter access and without an XML baseline
+    constexpr auto numStates = 500u;
+    const auto ids = stateParameterIds();
+    std::vector<state::Entry> entries;
+    for (auto i = 0u; i < ids.size(); ++i)
+        entries.push_back({ids[i], 0.25f * static_cast<float>(i)});
+
+    std::vector<std::vector<std::byte>> states(numStates);
+    chrono::StopWatch encodeStopWatch;
+    for (auto &bytes : states)
+    {
+        bytes.resize(state::encodedSize(entries));
+        state::encode(entries, bytes);
+    }
+    const auto encodeTime = encodeStopWatch.elapsed();
+
+    // matches ids like the plugin, in saved order
+    std::vector<float> values(ids.size());
+    chrono::StopWatch decodeStopWatch;
+    for (const auto &bytes : states)
+    {
+        auto index = 0u;
+        state::decode(bytes, [&](const state::Entry &entry) {
+            if (ids[index] == entry.id)
+                values[index++] = entry.value;
+        });
+    }
+    const auto decodeTime = decodeStopWatch.elapsed();
+    EXPECT_EQ(values.back(), entries.back().value);
+
+    std::cout << numStates << " states of " << states.front().size() << " bytes: encode " << 1e3 * encodeTime
+              << " ms, decode " << 1e3 * decodeTime << " ms" << std::endl;
+}
+
+}    // namespace sw::pitchtool::tests
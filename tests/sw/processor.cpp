@@ -0,0 +1,308 @@
+#include <gtest/gtest.h>
+#include <sw/pitchtool/processor.hpp>
+#include <sw/signals.hpp>
+
+namespace sw::pitchtool::tests {
+
+namespace {
+
+constexpr auto sampleRate = 48000.0;
+constexpr auto fftLength = 2048u;
+constexpr auto oversampling = 4u;
+constexpr auto stepSize = fftLength / oversampling;
+constexpr auto numSteps = 20u;
+
+template<typename P, size_t NumChannels>
+std::vector<double> processSignal(P &processor, const std::vector<double> &signal,
+                                  const std::array<ChannelParameters<double>, NumChannels> &channelParameters)
+{
+    const TuningParameters<double> tuningParameters;
+    std::vector<double> outSignal(signal.size());
+    for (auto i = 0u; i + stepSize <= signal.size(); i += stepSize)
+    {
+        processor.process(std::span(signal.begin() + i, stepSize), std::span(outSignal.begin() + i, stepSize),
+                          sampleRate, tuningParameters, channelParameters, 0.0);
+    }
+    return outSignal;
+}
+
+}    // namespace
+
+TEST(ProcessorTest, equalChannelsShareShifts)
+{
+    const auto signal = makeSineWave<double>(0.5, 330.0, sampleRate, numSteps * stepSize);
+
+    const std::array<ChannelParameters<double>, 1> singleParameters{{{std::monostate{}, 7.0, 3.0, 1.0}}};
+    Processor<double, 1> singleProcessor(fftLength, oversampling);
+    const auto singleOut = processSignal(singleProcessor, signal, singleParameters);
+
+    const std::array<ChannelParameters<double>, 2> doubleParameters{
+      {{std::monostate{}, 7.0, 3.0, 0.5}, {std::monostate{}, 7.0, 3.0, 0.5}}};
+    Processor<double, 2> doubleProcessor(fftLength, oversampling);
+    const auto doubleOut = processSignal(doubleProcessor, signal, doubleParameters);
+
+    for (auto i = 0u; i < signal.size(); ++i)
+        EXPECT_NEAR(singleOut[i], doubleOut[i], 1e-9);
+}
+
+TEST(ProcessorTest, voiceKeepsPhasesWhenMeetingOtherFactors)
+{
+    const auto signal = makeSineWave<double>(0.5, 330.0, sampleRate, 3u * numSteps * stepSize);
+    const auto pitchShift = [](const size_t step) {
+        return step < numSteps ? 5.0 : (step < 2u * numSteps ? 7.0 : 0.0);
+    };
+
+    // the second voice meets the shift of the first, then unity, and still sounds like a voice on its own
+    Processor<double, 1> singleProcessor(fftLength, oversampling);
+    Processor<double, 2> doubleProcessor(fftLength, oversampling);
+    std::vector<double> outSignal(stepSize);
+    for (auto step = 0u; (step + 1u) * stepSize <= signal.size(); ++step)
+    {
+        const auto stepSignal = std::span(signal.begin() + step * stepSize, stepSize);
+        const ChannelParameters<double> parameters{std::monostate{}, pitchShift(step), 3.0, 1.0};
+        singleProcessor.process(stepSignal, outSignal, sampleRate, TuningParameters<double>{},
+                                std::array{parameters}, 0.0);
+        doubleProcessor.process(stepSignal, outSignal, sampleRate, TuningParameters<double>{},
+                                std::array{ChannelParameters<double>{std::monostate{}, 7.0, 3.0, 1.0}, parameters},
+                                0.0);
+        for (auto i = 0u; i < stepSize; ++i)
+            EXPECT_NEAR(doubleProcessor.voiceSignal(1)[i], singleProcessor.voiceSignal(0)[i], 1e-9);
+    }
+}
+
+TEST(ProcessorTest, fixedEqualsDynamic)
+{
+    const auto signal = makeSineWave<double>(0.5, 330.0, sampleRate, numSteps * stepSize);
+    const std::array<ChannelParameters<double>, 2> channelParameters{
+      {{std::monostate{}, 7.0, 3.0, 0.5}, {std::monostate{}, -5.0, 0.0, 0.5}}};
+
+    Processor<double, 2> dynamicProcessor(fftLength, oversampling);
+    const auto dynamicOut = processSignal(dynamicProcessor, signal, channelParameters);
+
+    auto fixedProcessor = std::make_unique<FixedProcessor<double, 2, fftLength, oversampling>>();
+    const auto fixedOut = processSignal(*fixedProcessor, signal, channelParameters);
+
+    for (auto i = 0u; i < signal.size(); ++i)
+        EXPECT_NEAR(dynamicOut[i], fixedOut[i], 1e-9);
+}
+
+TEST(ProcessorTest, decimatedDetectionMatchesSpectrum)
+{
+    const auto signal = makeSineWave<double>(0.5, 220.0, sampleRate, 4u * numSteps * stepSize);
+    const std::array<ChannelParameters<double>, 1> mutedParameters{{{std::monostate{}, 0.0, 0.0, 0.0}}};
+
+    Processor<double, 1> spectrumProcessor(fftLength, oversampling);
+    Processor<double, 1> decimatedProcessor(fftLength, oversampling);
+    decimatedProcessor.setDetectionMode(detection::Mode::Decimated);
+    decimatedProcessor.setSpectrumRequested(false);
+
+    processSignal(spectrumProcessor, signal, mutedParameters);
+    processSignal(decimatedProcessor, signal, mutedParameters);
+
+    EXPECT_NEAR(spectrumProcessor.inFundamentalFrequency(), 220.0, 5.0);
+    EXPECT_NEAR(decimatedProcessor.inFundamentalFrequency(), spectrumProcessor.inFundamentalFrequency(), 5.0);
+}
+
+TEST(ProcessorTest, unmutedVoiceWaitsForPhaseRefresh)
+{
+    const auto signal = makeSineWave<double>(0.5, 220.0, sampleRate, 2u * numSteps * stepSize);
+    const auto mixGain = [](const size_t step, const size_t unmuteStep) { return step < unmuteStep ? 0.0 : 1.0; };
+
+    // analysis is skipped while muted, so the voice starts one step later, like one of a processor that kept analysing
+    Processor<double, 1> skippingProcessor(fftLength, oversampling);
+    skippingProcessor.setDetectionMode(detection::Mode::Decimated);
+    skippingProcessor.setSpectrumRequested(false);
+    Processor<double, 1> analysingProcessor(fftLength, oversampling);
+    analysingProcessor.setDetectionMode(detection::Mode::Decimated);
+    std::vector<double> outSignal(stepSize);
+    for (auto step = 0u; (step + 1u) * stepSize <= signal.size(); ++step)
+    {
+        const auto stepSignal = std::span(signal.begin() + step * stepSize, stepSize);
+        skippingProcessor.process(
+          stepSignal, outSignal, sampleRate, TuningParameters<double>{},
+          std::array{ChannelParameters<double>{std::monostate{}, 7.0, 3.0, mixGain(step, numSteps)}}, 0.0);
+        analysingProcessor.process(
+          stepSignal, outSignal, sampleRate, TuningParameters<double>{},
+          std::array{ChannelParameters<double>{std::monostate{}, 7.0, 3.0, mixGain(step, numSteps + 1u)}}, 0.0);
+        for (auto i = 0u; i < stepSize; ++i)
+            EXPECT_NEAR(skippingProcessor.voiceSignal(0)[i], analysingProcessor.voiceSignal(0)[i], 1e-9);
+    }
+}
+
+TEST(ProcessorTest, lookAheadDelaysByWholeSteps)
+{
+    constexpr auto lookAheadSteps = 3u;
+    const auto signal = makeSineWave<double>(0.5, 330.0, sampleRate, numSteps * stepSize);
+    const std::array<ChannelParameters<double>, 1> channelParameters{{{std::monostate{}, 7.0, 3.0, 1.0}}};
+
+    Processor<double, 1> processor(fftLength, oversampling);
+    const auto out = processSignal(processor, signal, channelParameters);
+
+    Processor<double, 1> lookAheadProcessor(fftLength, oversampling);
+    lookAheadProcessor.setLookAhead(lookAheadSteps);
+    EXPECT_EQ(lookAheadProcessor.lookAheadSize(), lookAheadSteps * stepSize);
+    const auto lookAheadOut = processSignal(lookAheadProcessor, signal, channelParameters);
+
+    for (auto i = lookAheadProcessor.lookAheadSize(); i < signal.size(); ++i)
+        EXPECT_NEAR(lookAheadOut[i], out[i - lookAheadProcessor.lookAheadSize()], 1e-9);
+}
+
+TEST(ProcessorTest, lookAheadSettlesNoteChangeAtDelayedOnset)
+{
+    constexpr auto lookAheadSteps = 3u;
+    auto signal = makeSineWave<double>(0.5, 220.0, sampleRate, numSteps * stepSize);
+    const auto nextNote = makeSineWave<double>(0.5, 330.0, sampleRate, numSteps * stepSize);
+    signal.insert(signal.end(), nextNote.begin(), nextNote.end());
+    const std::array<ChannelParameters<double>, 1> tunedParameters{{{tuning::AutoTune{{}}, 0.0, 0.0, 1.0}}};
+
+    // first step whose tuning follows the next note
+    const auto onsetStep = [&](auto &processor) {
+        std::vector<double> outSignal(stepSize);
+        for (auto step = 0u; (step + 1u) * stepSize <= signal.size(); ++step)
+        {
+            processor.process(std::span(signal.begin() + step * stepSize, stepSize), outSignal, sampleRate,
+                              TuningParameters<double>{}, tunedParameters, 0.0);
+            if (step >= numSteps && processor.inFundamentalFrequency() > 275.0)
+                return step;
+        }
+        return static_cast<unsigned>(signal.size() / stepSize);
+    };
+
+    Processor<double, 1> processor(fftLength, oversampling);
+    processor.setDetectionMode(detection::Mode::Decimated);
+    const auto onset = onsetStep(processor);
+    EXPECT_LT(onset, 2u * numSteps);
+
+    // the default spectrum detection as well, the median of the steps around the delayed onset settles it in time
+    Processor<double, 1> lookAheadProcessor(fftLength, oversampling);
+    lookAheadProcessor.setLookAhead(lookAheadSteps);
+    const auto lookAheadOnset = onsetStep(lookAheadProcessor);
+    EXPECT_GE(lookAheadOnset, onset + lookAheadSteps - 1u);
+    EXPECT_LE(lookAheadOnset, onset + lookAheadSteps + 1u);
+}
+
+TEST(ProcessorTest, voiceSignalsMixToOutput)
+{
+    const auto signal = makeSineWave<double>(0.5, 330.0, sampleRate, numSteps * stepSize);
+    const std::array<ChannelParameters<double>, 2> channelParameters{
+      {{std::monostate{}, 7.0, 3.0, 0.5}, {std::monostate{}, -5.0, 0.0, 0.25}}};
+    constexpr auto dryMixGain = 0.3;
+
+    Processor<double, 2> processor(fftLength, oversampling);
+    std::vector<double> outSignal(stepSize);
+    for (auto i = 0u; i + stepSize <= signal.size(); i += stepSize)
+    {
+        processor.process(std::span(signal.begin() + i, stepSize), outSignal, sampleRate, TuningParameters<double>{},
+                          channelParameters, dryMixGain);
+        for (auto j = 0u; j < stepSize; ++j)
+        {
+            const auto mix = dryMixGain * processor.drySignal()[j] +
+                             channelParameters[0].mixGain * processor.voiceSignal(0)[j] +
+                             channelParameters[1].mixGain * processor.voiceSignal(1)[j];
+            EXPECT_NEAR(outSignal[j], mix, 1e-12);
+        }
+    }
+}
+
+TEST(ProcessorTest, requestedVoiceIsSynthesizedAtZeroMixGain)
+{
+    const auto signal = makeSineWave<double>(0.5, 330.0, sampleRate, numSteps * stepSize);
+    const std::array<ChannelParameters<double>, 2> audibleParameters{
+      {{std::monostate{}, 7.0, 3.0, 0.5}, {std::monostate{}, -5.0, 0.0, 0.25}}};
+    auto mutedParameters = audibleParameters;
+    mutedParameters[1].mixGain = 0.0;
+    constexpr auto dryMixGain = 0.3;
+
+    // the requested voice sounds like an audible one, but is left out of the mix
+    Processor<double, 2> audibleProcessor(fftLength, oversampling);
+    Processor<double, 2> requestedProcessor(fftLength, oversampling);
+    requestedProcessor.setVoiceSignalsRequested({false, true});
+    std::vector<double> audibleSignal(stepSize);
+    std::vector<double> outSignal(stepSize);
+    for (auto i = 0u; i + stepSize <= signal.size(); i += stepSize)
+    {
+        audibleProcessor.process(std::span(signal.begin() + i, stepSize), audibleSignal, sampleRate,
+                                 TuningParameters<double>{}, audibleParameters, dryMixGain);
+        requestedProcessor.process(std::span(signal.begin() + i, stepSize), outSignal, sampleRate,
+                                   TuningParameters<double>{}, mutedParameters, dryMixGain);
+        for (auto j = 0u; j < stepSize; ++j)
+        {
+            EXPECT_NEAR(requestedProcessor.voiceSignal(1)[j], audibleProcessor.voiceSignal(1)[j], 1e-12);
+            const auto mix = dryMixGain * requestedProcessor.drySignal()[j] +
+                             mutedParameters[0].mixGain * requestedProcessor.voiceSignal(0)[j];
+            EXPECT_NEAR(outSignal[j], mix, 1e-12);
+        }
+    }
+}
+
+TEST(ProcessorTest, silentSpectraArePublishedOnce)
+{
+    const auto signal = makeSineWave<double>(0.5, 330.0, sampleRate, numSteps * stepSize);
+    const std::array<ChannelParameters<double>, 1> mutedParameters{{{std::monostate{}, 7.0, 3.0, 0.0}}};
+
+    // bypassed steps and muted voices keep the frame of their empty spectrum, so displays skip redrawing it
+    Processor<double, 1> processor(fftLength, oversampling);
+    std::vector<double> outSignal(stepSize);
+    for (auto step = 0u; (step + 1u) * stepSize <= signal.size(); ++step)
+    {
+        processor.process(std::span(signal.begin() + step * stepSize, stepSize), outSignal, sampleRate,
+                          TuningParameters<double>{}, mutedParameters, 0.0);
+        EXPECT_TRUE(processor.outputSpectrum(0).empty());
+        EXPECT_EQ(processor.outputSpectrumFrame(0), 1u);
+    }
+
+    std::optional<std::uint64_t> bypassedFrame;
+    for (auto step = 0u; (step + 1u) * stepSize <= signal.size(); ++step)
+    {
+        processor.processByPassed(std::span(signal.begin() + step * stepSize, stepSize), outSignal);
+        EXPECT_TRUE(processor.inputSpectrum().empty());
+        EXPECT_EQ(processor.inputSpectrumFrame(), bypassedFrame.value_or(processor.inputSpectrumFrame()));
+        bypassedFrame = processor.inputSpectrumFrame();
+        EXPECT_EQ(processor.outputSpectrumFrame(0), 1u);
+    }
+}
+
+TEST(ProcessorTest, analysisCacheKeepsLoopOutput)
+{
+    constexpr auto loopSteps = 12u;
+    const auto loop = makeSineWave<double>(0.5, 330.0, sampleRate, loopSteps * stepSize);
+    std::vector<double> signal(loop);
+    signal.insert(signal.end(), loop.begin(), loop.end());
+    const std::array<ChannelParameters<double>, 1> channelParameters{{{std::monostate{}, 7.0, 3.0, 1.0}}};
+
+    Processor<double, 1> processor(fftLength, oversampling);
+    const auto out = processSignal(processor, signal, channelParameters);
+
+    AnalysisCache<double> cache(fftLength, stepSize, 1u << 24u);
+    Processor<double, 1> cachedProcessor(fftLength, oversampling);
+    cachedProcessor.setAnalysisCache(&cache);
+    std::vector<double> cachedOut(signal.size());
+    for (auto i = 0u; i + stepSize <= signal.size(); i += stepSize)
+    {
+        cachedProcessor.setCachePosition(static_cast<std::int64_t>(i % loop.size()));
+        cachedProcessor.process(std::span(signal.begin() + i, stepSize), std::span(cachedOut.begin() + i, stepSize),
+                                sampleRate, TuningParameters<double>{}, channelParameters, 0.0);
+    }
+
+    // the second pass finds all steps whose window and previous window lie within the loop
+    EXPECT_EQ(cache.numHits(), loopSteps - oversampling);
+    for (auto i = 0u; i < signal.size(); ++i)
+        EXPECT_NEAR(cachedOut[i], out[i], 1e-9);
+}
+
+TEST(ProcessorTest, sizesFromDurations)
+{
+    const auto at48k = sizes::fromDurations(48000.0, 2048.0 / 48000.0, 256.0 / 48000.0);
+    EXPECT_EQ(at48k.fftLength(), 2048u);
+    EXPECT_EQ(at48k.overSampling(), 8u);
+
+    const auto at96k = sizes::fromDurations(96000.0, 2048.0 / 48000.0, 256.0 / 48000.0);
+    EXPECT_EQ(at96k.fftLength(), 4096u);
+    EXPECT_EQ(at96k.overSampling(), 8u);
+
+    const auto tiny = sizes::fromDurations(8000.0, 0.001, 0.0001);
+    EXPECT_EQ(tiny.fftLength(), 64u);
+    EXPECT_EQ(tiny.overSampling(), 4u);
+}
+
+}    // namespace sw::pitchtool::tests
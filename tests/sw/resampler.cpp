@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include <sw/pitchtool/resampler.hpp>
+#include <sw/signals.hpp>
+
+namespace sw::pitchtool::tests {
+
+TEST(ResamplerTest, passesBandDelayedByLatency)
+{
+    constexpr auto sampleRate = 96000.0;
+    const auto signal = makeSineWave<double>(1.0, 1000.0, sampleRate, 20000u);
+
+    for (const auto factor : {2u, 4u})
+    {
+        Resampler<double> resampler(factor);
+        std::vector<double> outSignal(signal.size());
+        const auto copy = [](const auto lowSignal, const auto o_lowSignal) {
+            std::ranges::copy(lowSignal, o_lowSignal.begin());
+        };
+        // odd block sizes, smaller and larger than the resampler chunks
+        size_t blockSize = 37u;
+        for (size_t offset = 0u; offset < signal.size(); offset += blockSize)
+        {
+            blockSize = blockSize == 37u ? 1500u : 37u;
+            const auto size = std::min(blockSize, signal.size() - offset);
+            resampler.process(std::span(signal).subspan(offset, size), std::span(outSignal).subspan(offset, size),
+                              copy);
+        }
+
+        const auto latency = resampler.latency();
+        for (auto i = 5000u; i < signal.size(); ++i)
+            EXPECT_NEAR(outSignal[i], signal[i - latency], 1e-3);
+    }
+}
+
+}    // namespace sw::pitchtool::tests
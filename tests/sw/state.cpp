@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <sw/pitchtool/state.hpp>
+
+#include <string>
+#include <vector>
+
+namespace sw::pitchtool::tests {
+
+namespace {
+
+/// ids and values like the ones of the plugin
+std::vector<std::string> parameterIds()
+{
+    std::vector<std::string> ids{"dryMixGain", "envelopeFormants", "adaptiveQuality", "window", "hop",
+                                 "resampling", "decimatedDetection", "doublePrecision", "offlineQuality",
+                                 "analysisCache", "bandLimited", "bandLow", "bandHigh", "frequenciesLogScale",
+                                 "gainsLogScale", "standardPitch", "averagingTime", "holdTime", "attackTime"};
+    for (const auto *channel : {"1", "2"})
+    {
+        for (const auto *name : {"tuning_", "pitchShift_", "formantsShift_", "mixGain_"})
+            ids.push_back(name + std::string(channel));
+    }
+    return ids;
+}
+
+std::vector<state::Entry> makeEntries(const std::vector<std::string> &ids)
+{
+    std::vector<state::Entry> entries;
+    for (auto i = 0u; i < ids.size(); ++i)
+        entries.push_back({ids[i], 0.25f * static_cast<float>(i)});
+    return entries;
+}
+
+}    // namespace
+
+TEST(StateTest, roundTrip)
+{
+    const auto ids = parameterIds();
+    const auto entries = makeEntries(ids);
+    std::vector<std::byte> bytes(state::encodedSize(entries));
+    state::encode(entries, bytes);
+
+    std::vector<state::Entry> decoded;
+    EXPECT_TRUE(state::decode(bytes, [&](const state::Entry &entry) { decoded.push_back(entry); }));
+    ASSERT_EQ(decoded.size(), entries.size());
+    for (auto i = 0u; i < entries.size(); ++i)
+    {
+        EXPECT_EQ(decoded[i].id, entries[i].id);
+        EXPECT_EQ(decoded[i].value, entries[i].value);
+    }
+}
+
+TEST(StateTest, rejectsOtherStates)
+{
+    const auto ids = parameterIds();
+    const auto entries = makeEntries(ids);
+    std::vector<std::byte> bytes(state::encodedSize(entries));
+    state::encode(entries, bytes);
+    const auto visitNothing = [](const state::Entry &) { FAIL(); };
+
+    EXPECT_FALSE(state::decode(std::span(bytes).first(bytes.size() - 1u), visitNothing));
+
+    auto newerBytes = bytes;
+    newerBytes[state::magic.size()] = std::byte{state::version + 1u};
+    EXPECT_FALSE(state::decode(newerBytes, visitNothing));
+
+    const std::string xml{"<?xml version=\"1.0\" encoding=\"UTF-8\"?><state/>"};
+    EXPECT_FALSE(state::isEncoded(std::as_bytes(std::span(xml))));
+}
+
+}    // namespace sw::pitchtool::tests
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <sw/pitchtool/track.hpp>
+#include <sw/pitchtool/trackexport.hpp>
+#include <sw/signals.hpp>
+
+#include <sstream>
+
+namespace sw::pitchtool::tests {
+
+namespace {
+
+constexpr auto sampleRate = 48000.0;
+
+/// two seconds of A3 followed by two seconds of E4
+std::vector<double> twoNotesSignal()
+{
+    auto signal = makeSineWave<double>(0.5, 220.0, sampleRate, 96000u);
+    const auto second = makeSineWave<double>(0.5, 329.63, sampleRate, 96000u);
+    signal.insert(signal.end(), second.begin(), second.end());
+    return signal;
+}
+
+}    // namespace
+
+TEST(TrackTest, segmentsMatchWholeSignal)
+{
+    const auto signal = twoNotesSignal();
+
+    track::Settings<double> wholeSettings;
+    wholeSettings.segmentDuration = 10.0;
+    const auto wholePoints = track::extract<double>(signal, sampleRate, wholeSettings);
+
+    track::Settings<double> segmentedSettings;
+    segmentedSettings.segmentDuration = 0.5;
+    segmentedSettings.numThreads = 4u;
+    const auto segmentedPoints = track::extract<double>(signal, sampleRate, segmentedSettings);
+
+    ASSERT_EQ(wholePoints.size(), segmentedPoints.size());
+    for (auto i = 0u; i < wholePoints.size(); ++i)
+    {
+        EXPECT_DOUBLE_EQ(wholePoints[i].time, segmentedPoints[i].time);
+        EXPECT_NEAR(wholePoints[i].frequency, segmentedPoints[i].frequency, 1.0);
+    }
+}
+
+TEST(TrackTest, notesOfTwoTones)
+{
+    const auto points = track::extract<double>(twoNotesSignal(), sampleRate);
+    const auto notes = track::toNotes<double>(points);
+
+    ASSERT_EQ(notes.size(), 2u);
+    EXPECT_EQ(notes[0].midiNote, 57);
+    EXPECT_EQ(notes[1].midiNote, 64);
+    EXPECT_NEAR(notes[1].begin, 2.0, 0.1);
+
+    std::ostringstream midi;
+    track::writeMidi<double>(midi, notes);
+    EXPECT_EQ(midi.str().substr(0u, 4u), "MThd");
+}
+
+}    // namespace sw::pitchtool::tests
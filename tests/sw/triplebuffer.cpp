@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <sw/pitchtool/triplebuffer.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace sw::pitchtool::tests {
+
+TEST(TripleBufferTest, framesCountPushes)
+{
+    TripleBuffer<int> buffer(0);
+    EXPECT_EQ(buffer.pull(), 0);
+    EXPECT_EQ(buffer.frame(), 0u);
+    EXPECT_FALSE(buffer.isPending());
+
+    buffer.inBuffer() = 1;
+    buffer.push();
+    EXPECT_TRUE(buffer.isPending());
+    buffer.inBuffer() = 2;
+    buffer.push();
+
+    EXPECT_EQ(buffer.pull(), 2);    // the latest one replaced the one not pulled
+    EXPECT_EQ(buffer.frame(), 2u);
+    EXPECT_FALSE(buffer.isPending());
+    EXPECT_EQ(buffer.pull(), 2);
+    EXPECT_EQ(buffer.frame(), 2u);
+}
+
+TEST(TripleBufferTest, readsDoNotTear)
+{
+    constexpr auto numPushes = 100000;
+    TripleBuffer<std::vector<int>> buffer(std::vector<int>(64u, 0));
+
+    std::jthread writer([&]() {
+        for (auto i = 1; i <= numPushes; ++i)
+        {
+            std::ranges::fill(buffer.inBuffer(), i);
+            buffer.push();
+        }
+    });
+
+    std::uint64_t lastFrame{0u};
+    while (lastFrame < static_cast<std::uint64_t>(numPushes))
+    {
+        const auto &values = buffer.pull();
+        const auto frame = buffer.frame();
+        ASSERT_GE(frame, lastFrame);
+        ASSERT_EQ(static_cast<std::uint64_t>(values.front()), frame);
+        for (const auto value : values)
+            ASSERT_EQ(value, values.front());
+        lastFrame = frame;
+    }
+}
+
+}    // namespace sw::pitchtool::tests